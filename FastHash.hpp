@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * 64 位快速哈希, 按 wyhash 的思路实现:
+ * 每次读入 8 字节, 用 64x64->128 位乘法把高低两半异或混合,
+ * 大块数据三路并行, 不依赖查表, 短行和整文件都能跑满。
+ * 只用于判等和建哈希表, 不具备密码学强度。
+ */
+namespace fast_hash {
+
+    static constexpr uint64_t SECRET[4] = {
+            0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+            0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+    };
+
+    static inline void mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = static_cast<__uint128_t>(*a) * *b;
+        *a = static_cast<uint64_t>(r);
+        *b = static_cast<uint64_t>(r >> 64);
+#else
+        uint64_t ha = *a >> 32, hb = *b >> 32, la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        *a = lo;
+        *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    static inline uint64_t mix(uint64_t a, uint64_t b) {
+        mum(&a, &b);
+        return a ^ b;
+    }
+
+    static inline uint64_t read8(const uint8_t *p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    static inline uint64_t read4(const uint8_t *p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    static inline uint64_t read3(const uint8_t *p, size_t k) {
+        return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+    }
+}
+
+static inline uint64_t fast_hash64(const void *key, size_t len, uint64_t seed = 0) {
+    using namespace fast_hash;
+    const auto *p = static_cast<const uint8_t *>(key);
+    seed ^= mix(seed ^ SECRET[0], SECRET[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+                see1 = mix(read8(p + 16) ^ SECRET[2], read8(p + 24) ^ see1);
+                see2 = mix(read8(p + 32) ^ SECRET[3], read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = mix(read8(p) ^ SECRET[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+    a ^= SECRET[1];
+    b ^= seed;
+    mum(&a, &b);
+    return mix(a ^ SECRET[0] ^ len, b ^ SECRET[1]);
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FastHash.hpp"
+
+/**
+ * 只读私有映射的一个文件, 最后一个持有者释放时解除映射
+ */
+struct MappedFile {
+    void *addr;
+    size_t length;
+
+    MappedFile(void *addr, size_t length) : addr(addr), length(length) {}
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        ::munmap(addr, length);
+    }
+};
+
+/**
+ * 文件的一个版本
+ * 小文件整个读进 contents; 不小于 mmap_threshold 的大文件用 MAP_PRIVATE 映射,
+ * 内容通过 data() 访问, 版本之间不再各自占一份堆内存。
+ * 私有映射只在页被写时才复制, 对映射之外的写入并不隔离:
+ * 先写临时文件再改名的保存方式换了 inode, 旧 inode 的映射不受影响;
+ * 原地截断或改写会改掉映射里的内容, 截短后访问越界的页还会触发 SIGBUS。
+ * 所以碰映射的页之前要先用 mapping_overwritten() 确认文件没被原地改写过。
+ */
+struct FileInfo {
+    std::string fileName;
+    std::string contents;
+    std::shared_ptr<const MappedFile> mapping;  // 大文件或快照缓存的映射, 多个拷贝共享
+    std::string_view mapped;                    // 映射里属于这个版本的内容
+    std::chrono::time_point<std::chrono::system_clock> timeval;
+    uint64_t hash = 0;                          // 内容哈希, 读取时顺带算出
+    bool hashed = false;                        // hash 是否有效, 只取元数据且不算哈希时为 false
+    uint64_t size = 0;                          // 读到的字节数
+    int64_t mtime = 0;                          // 读取时 fstat 得到的修改时间(纳秒)
+    uint64_t dev = 0;                           // 读取时的设备号和 inode, 用来判断映射的文件是不是被原地改写了
+    uint64_t ino = 0;
+    bool file_mapped = false;                   // mapping 映射的是文件本身, 而不是快照缓存
+public:
+    FileInfo() = delete;
+
+    FileInfo(const FileInfo &) = default;
+
+    FileInfo(FileInfo &&) = default;
+
+    FileInfo &operator=(const FileInfo &) = delete;
+
+    FileInfo &operator=(FileInfo &&) = default;
+
+    /**
+     * buffer 是可以复用的旧缓冲区, 读取时沿用它的容量, 省掉一次分配
+     */
+    FileInfo(const std::string &fileName, size_t mmap_threshold = 0, std::string buffer = {}) {
+        this->fileName = fileName;
+        timeval = std::chrono::system_clock::now();
+        contents = std::move(buffer);
+        contents.clear();
+        read_all_contents(mmap_threshold);
+    }
+
+    /**
+     * 只取元数据的版本, 不保留内容。
+     * 默认只 stat 得到大小和修改时间; with_hash 时读一遍内容算出哈希后就丢掉,
+     * 之后仍能判断内容有没有变。
+     */
+    static FileInfo metadata_only(const std::string &fileName, bool with_hash, size_t mmap_threshold = 0) {
+        return FileInfo(fileName, with_hash, mmap_threshold, MetadataTag{});
+    }
+
+    /**
+     * 文件内容, 不管是读进来的还是映射的。
+     * 版本被淘汰成只剩元数据时为空, 此时 hash、size、mtime 仍然有效。
+     */
+    std::string_view data() const {
+        if (mapping)
+            return mapped;
+        return contents;
+    }
+
+    /**
+     * 磁盘上文件的大小和修改时间与读取时一致, 多半没有变化。
+     * 时间戳精度有限, 紧挨着的两次同样大小的写入可能分辨不出来。
+     */
+    bool same_stat() const {
+        struct stat st{};
+        return ::stat(fileName.c_str(), &st) == 0 &&
+               static_cast<uint64_t>(st.st_size) == size && stat_mtime(st) == mtime;
+    }
+
+    /**
+     * 映射的文件被原地改写过, 映射里已经不是这个版本的内容, 不能再访问。
+     * 路径仍然指向映射的那个 inode, 且大小或修改时间变了, 就算改写过。只看元数据, 不碰映射的页。
+     */
+    bool mapping_overwritten() const {
+        if (!file_mapped)
+            return false;
+        struct stat st{};
+        return ::stat(fileName.c_str(), &st) == 0 &&
+               static_cast<uint64_t>(st.st_dev) == dev && static_cast<uint64_t>(st.st_ino) == ino &&
+               (static_cast<uint64_t>(st.st_size) != size || stat_mtime(st) != mtime);
+    }
+
+    /**
+     * 路径现在指向的是不是另一个 inode, 即文件是先写临时文件再改名换上来的
+     */
+    bool replaced() const {
+        struct stat st{};
+        return ::stat(fileName.c_str(), &st) == 0 &&
+               (static_cast<uint64_t>(st.st_dev) != dev || static_cast<uint64_t>(st.st_ino) != ino);
+    }
+
+    /**
+     * 内容占用的内存, 映射的内容按这个版本所占的长度算
+     */
+    size_t bytes() const {
+        return contents.capacity() + (mapping ? mapped.size() : 0);
+    }
+
+    /**
+     * 丢掉内容, 只留元数据
+     */
+    void release_contents() {
+        std::string().swap(contents);
+        mapping.reset();
+        mapped = {};
+        file_mapped = false;
+    }
+
+    bool same_contents(const FileInfo &other) const {
+        return hashed && other.hashed && hash == other.hash && size == other.size;
+    }
+
+private:
+    struct MetadataTag {
+    };
+
+    FileInfo(const std::string &fileName, bool with_hash, size_t mmap_threshold, MetadataTag) {
+        this->fileName = fileName;
+        timeval = std::chrono::system_clock::now();
+        if (with_hash) {
+            read_all_contents(mmap_threshold);
+            release_contents();
+            return;
+        }
+        struct stat st{};
+        if (::stat(fileName.c_str(), &st) == 0) {
+            size = st.st_size;
+            mtime = stat_mtime(st);
+            dev = st.st_dev;
+            ino = st.st_ino;
+        }
+    }
+
+    void read_all_contents(size_t mmap_threshold) {
+        std::FILE *fp = std::fopen(fileName.c_str(), "r");
+        if (fp) {
+            struct stat st{};
+            if (::fstat(fileno(fp), &st) == 0) {
+                size = st.st_size;
+                mtime = stat_mtime(st);
+                dev = st.st_dev;
+                ino = st.st_ino;
+            }
+            if (mmap_threshold && size >= mmap_threshold && map_contents(fileno(fp))) {
+                hash = fast_hash64(mapped.data(), mapped.size());
+                hashed = true;
+                // 读的同时被改写了, 映射里的内容靠不住, 改成读进内存
+                if (::fstat(fileno(fp), &st) == 0 &&
+                    (static_cast<uint64_t>(st.st_size) != size || stat_mtime(st) != mtime)) {
+                    release_contents();
+                    size = st.st_size;
+                    mtime = stat_mtime(st);
+                }
+            }
+            if (!file_mapped) {
+                contents.resize(size);
+                contents.resize(std::fread(&contents[0], 1, contents.size(), fp));
+                size = contents.size();
+            }
+            std::fclose(fp);
+        }
+        if (file_mapped)
+            return;
+        hash = fast_hash64(contents.data(), contents.size());
+        hashed = true;
+    }
+
+    /**
+     * 映射失败时返回 false, 退回普通读取
+     */
+    bool map_contents(int fd) {
+        void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+            return false;
+        // 算哈希和建行索引都是从头到尾扫一遍, 让内核多预读
+        ::madvise(addr, size, MADV_SEQUENTIAL);
+        mapping = std::make_shared<const MappedFile>(addr, size);
+        mapped = {static_cast<const char *>(addr), size};
+        file_mapped = true;
+        return true;
+    }
+
+    static int64_t stat_mtime(const struct stat &st) {
+#ifdef __APPLE__
+        return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    }
+
+};
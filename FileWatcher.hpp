@@ -13,40 +13,16 @@
 #include <unordered_set>
 #include <vector>
 #include <filesystem>
+#include <memory>
 #include "dtl/Color.hpp"
+#include "FileInfo.hpp"
+#include "InotifyWatcher.hpp"
+#include "ParallelScan.hpp"
+#include "PathFilter.hpp"
+#include "SnapshotCache.hpp"
+#include "VersionStore.hpp"
 #include "unidiff.h"
 
-struct FileInfo {
-    std::string fileName;
-    std::string contents;
-    std::chrono::time_point<std::chrono::system_clock> timeval;
-public:
-    FileInfo() = delete;
-
-    FileInfo(const FileInfo &) = default;
-
-    FileInfo &operator=(const FileInfo &) = delete;
-
-    FileInfo(const std::string &fileName) {
-        this->fileName = fileName;
-        timeval = std::chrono::system_clock::now();
-        read_all_contents();
-    }
-
-private:
-    void read_all_contents() {
-        std::FILE *fp = std::fopen(fileName.c_str(), "r");
-        if (fp) {
-            std::fseek(fp, 0, SEEK_END);
-            contents.resize(std::ftell(fp));
-            std::rewind(fp);
-            std::fread(&contents[0], 1, contents.size(), fp);
-            std::fclose(fp);
-        }
-    }
-
-};
-
 
 struct ConfigurationFileWatcher {
 public:
@@ -57,6 +33,19 @@ public:
     const int MAX_BUFF;                         //最大读取文件缓冲区大小
     std::vector<std::string> _suffix_files;     //监听的文件后缀
     string root;                                //监听的根节点
+    unsigned debounce_ms = 50;                  //同一文件静默多久后才读取(毫秒), 0 表示每个事件都读
+    bool is_stat_precheck = false;              //大小和修改时间都没变时不读文件
+    size_t mmap_threshold = 0;                  //不小于这个大小的文件用 mmap 映射, 0 表示都读进内存
+    size_t memory_budget = 0;                   //所有文件版本合计的内存上限(字节), 超出时按 LRU 淘汰, 0 表示不限
+    bool is_lazy_pre_read = false;              //预读时只记录大小和修改时间, 不保留内容
+    bool is_lazy_hash = false;                  //只记录元数据时是否顺带算出内容哈希
+    bool is_completed_writes = false;           //只处理写完的文件(关闭写入或改名移入), 忽略中间的修改, 仅 Linux
+    std::string snapshot_path;                  //快照缓存文件, 预读时从中恢复基线, 析构时保存, 为空表示不用
+    std::vector<std::string> include_globs;     //只处理匹配这些 glob 的文件, 为空表示不限
+    std::vector<std::string> exclude_globs;     //排除的文件和目录, 写法同 .gitignore, 如 "build/"、"node_modules"
+    bool is_gitignore = false;                  //是否把根目录下 .gitignore 的规则也当作排除规则
+    unsigned scan_threads = 0;                  //预读时遍历目录的线程数, 0 表示按 CPU 核数
+    size_t snapshot_every = 8;                  //每隔多少个版本保留一份完整内容, 其余存差量, 0 表示只有最新版本完整
 };
 
 class FileWatcher {
@@ -68,9 +57,27 @@ private:
 private:
     uv_loop_t *_loop;
     uv_fs_event_t *_fs_event{};
+#ifdef __linux__
+    std::unique_ptr<InotifyWatcher> _inotify;   // Linux 上递归监听用 inotify
+#endif
 
 private:
     void init_loop() {
+#ifdef __linux__
+        if (_is_recursive || _completed_writes) {
+            _inotify = std::make_unique<InotifyWatcher>(
+                    _loop, _completed_writes ? InotifyWatcher::DEFAULT_MASK | InotifyWatcher::COMPLETED_MASK
+                                             : InotifyWatcher::DEFAULT_MASK,
+                    [this](const std::string &path, uint32_t mask) { on_inotify_event(path, mask); });
+            _inotify->set_dir_filter([this](const std::string &dir) { return _filter.accept_dir(dir); });
+            int status = _inotify->start(_dir, _is_recursive);
+            if (status < 0) {
+                fprintf(stderr, "Error watching file: %s\n", uv_strerror(status));
+                exit(1);
+            }
+            return;
+        }
+#endif
         _fs_event = new uv_fs_event_t;
         uv_fs_event_init(_loop, _fs_event);
         _fs_event->data = this;
@@ -78,6 +85,49 @@ private:
         uv_fs_event_start(_fs_event, on_fs_event, _dir.c_str(), flag);
     }
 
+private:
+    /**
+     * 一次文件变化的处理任务
+     * 读文件和比较差异在 libuv 线程池里做, 结果在 after_work 回调里回到事件循环线程。
+     * 同一个文件同时只有一个任务在跑, 任务期间再来的事件只记一笔, 跑完再读一次,
+     * 所以版本按顺序入库, 工作线程读到的上一版本也不会被换掉。
+     */
+    struct ChangeJob {
+        uv_work_t req{};
+        FileWatcher *watcher;
+        std::string fileName;
+        const FileInfo *previous;               // 入队时最新的版本, 没有则为空
+        bool previous_stub = false;             // 上一版本只剩元数据, 没法比较差异
+        bool previous_lost = false;             // 上一版本映射的文件被原地改写了, 内容已经找不回来
+        std::unique_ptr<FileInfo> current;      // 工作线程读到的新版本, 内容没变时为空
+        std::string diff;                       // 渲染好的差异
+        std::string buffer;                     // 版本库的备用缓冲区, 读文件时复用
+        bool needs_delta = false;               // 上一版本入库后要降为差量
+        std::unique_ptr<VersionStore::Delta> delta;  // 从新版本还原上一版本的差量
+    };
+
+    /**
+     * 每个文件的待处理状态
+     * 编辑器保存一次会连着发好几个事件, 事件到来后先等 debounce_ms 的静默期,
+     * 期间再来的事件只把计时器往后推, 静默期过了才真正读一次文件。
+     * 条目在表里常驻, 计时器嵌在条目里, 节点地址不会因为扩容而变化。
+     */
+    struct PendingChange {
+        uv_timer_t timer{};
+        bool timer_inited = false;
+        FileWatcher *watcher = nullptr;
+        const std::string *fileName = nullptr;  // 指向表里的键
+        bool waiting = false;                   // 计时器在等静默期结束
+        bool running = false;                   // 是否有任务在跑
+        bool again = false;                     // 任务期间又收到了事件
+        ChangeJob *job = nullptr;               // 在跑的任务, 析构时用来取消
+    };
+
+    std::unordered_map<std::string, PendingChange> _pending_changes;
+    size_t _jobs_in_flight = 0;                 // 已交给线程池还没回调的任务数
+    bool _closing = false;                      // 正在析构, 不再接收事件, 也不再展示
+    size_t _handles_closing = 0;                // 已经 uv_close 还没回调的句柄数
+
 private:
     function<void(const FileWatcher *)> default_print_callback;
 
@@ -88,10 +138,40 @@ private:
 public:
     std::string _dir;
     bool _show;
-    std::unordered_map<std::string, std::vector<FileInfo *>> _files_versions;
+    unsigned _debounce_ms;
+    bool _stat_precheck;
+    size_t _mmap_threshold;
+    size_t _snapshot_every;
+    size_t _memory_budget;
+    unsigned _scan_threads;
+    bool _lazy_pre_read;
+    bool _lazy_hash;
+    std::string _snapshot_path;
+    bool _completed_writes;
+    std::vector<std::string> _include_globs;
+    std::vector<std::string> _exclude_globs;
+    bool _gitignore;
+    PathFilter _filter;                         // 由后缀和 glob 编译出的过滤器, 配置变化时重新编译
+    uint64_t _use_clock = 0;                    // 每次使用版本库加一, 作为 LRU 的时间
+    std::unordered_map<std::string, VersionStore> _files_versions;
     std::unordered_set<std::string> _suffix_files;
     std::vector<std::function<void(FileWatcher *)>> _print_callbacks;
     std::string _now_changed_file;
+    std::string _now_changed_diff;                  //最近一次变化与上一版本的差异
+    size_t _events_received = 0;                    //收到的文件事件数
+    size_t _events_coalesced = 0;                   //被合并进其他读取、没有单独读文件的事件数
+    size_t _events_suppressed = 0;                  //只处理写完的文件时丢掉的中间事件数
+    size_t _changes_unchanged = 0;                  //读取后发现内容没变的次数
+    size_t _memory_used = 0;                        //所有版本库合计占用的内存(字节)
+    size_t _files_evicted = 0;                      //因超出内存上限被淘汰成存根的次数
+
+    struct ScanStats {
+        size_t files = 0;                           //预读的文件数
+        uint64_t bytes = 0;                         //实际从文件里读出的字节数, 快照恢复和只取元数据的不算
+        size_t restored = 0;                        //内容从快照缓存恢复的文件数
+        size_t stubs = 0;                           //只取了元数据的文件数
+        double seconds = 0;                         //预读耗时
+    } _scan_stats;
     bool _is_pre_read;
     bool _is_recursive;
 
@@ -109,8 +189,22 @@ public:
         _show = config.is_show;
         _is_pre_read = config.is_pre_read;
         _is_recursive = config.is_recursive;
+        _debounce_ms = config.debounce_ms;
+        _stat_precheck = config.is_stat_precheck;
+        _mmap_threshold = config.mmap_threshold;
+        _snapshot_every = config.snapshot_every;
+        _memory_budget = config.memory_budget;
+        _scan_threads = config.scan_threads;
+        _lazy_pre_read = config.is_lazy_pre_read;
+        _lazy_hash = config.is_lazy_hash;
+        _snapshot_path = config.snapshot_path;
+        _completed_writes = config.is_completed_writes;
+        _include_globs = config.include_globs;
+        _exclude_globs = config.exclude_globs;
+        _gitignore = config.is_gitignore;
         auto &_suffix = config._suffix_files;
         _suffix_files = std::move(unordered_set(_suffix.begin(), _suffix.end()));
+        compile_filter();
         MAX_DIFF_SIZE = config.MAX_DIFF ? config.MAX_DIFF : 1 << 4;
         MAX_BUFF_SIZE = config.MAX_BUFF ? config.MAX_BUFF : (1 << 10) + 1;
         if (_is_pre_read)
@@ -120,12 +214,60 @@ public:
 
     /**
      * 预先读取所有文件 用以最开始进行比较的情况
+     * 遍历和读取在多个线程里并行做, 读完后在当前线程一次性存入版本库。
+     * 惰性预读只记录元数据, 存成存根, 启动开销与文件个数成正比而不是与字节数;
+     * 存根没有旧内容, 文件第一次变化时只能判断变没变, 没有差异可展示。
+     * 配置了快照缓存时, 大小和修改时间没变的文件直接用快照里的内容作基线, 惰性预读也一样。
      **/
     void pre_read_files() {
         namespace fs = std::filesystem;
-        const std::string &root = _dir;
-        _is_recursive ? traverseDirectory<fs::recursive_directory_iterator>(root)
-                      : traverseDirectory<fs::directory_iterator>(root);
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<SnapshotCache> snapshot;
+        if (!_snapshot_path.empty())
+            snapshot = std::make_unique<SnapshotCache>(_snapshot_path);
+
+        struct ScannedFile {
+            FileInfo info;
+            bool stub;                          // 只有元数据
+            bool restored;                      // 内容来自快照
+            bool read;                          // 读过文件内容, 惰性预读算哈希时也要读
+        };
+        std::vector<ScannedFile> scanned = parallel_scan_directory<ScannedFile>(
+                _dir, _is_recursive, _scan_threads,
+                [this](const fs::directory_entry &entry) {
+                    return _filter.accept_dir(entry.path().lexically_normal().string());
+                },
+                [this, &snapshot](const fs::directory_entry &entry, std::vector<ScannedFile> &out) {
+                    std::string fileName = entry.path().lexically_normal();
+                    if (!_filter.accept_file(fileName))
+                        return;
+                    if (snapshot) {
+                        FileInfo info = FileInfo::metadata_only(fileName, false);
+                        if (snapshot->restore(info)) {
+                            out.push_back(ScannedFile{std::move(info), false, true, false});
+                            return;
+                        }
+                        // 快照里只有哈希时惰性预读也不用再读一遍
+                        if (_lazy_pre_read && (info.hashed || !_lazy_hash)) {
+                            out.push_back(ScannedFile{std::move(info), true, false, false});
+                            return;
+                        }
+                    }
+                    if (_lazy_pre_read)
+                        out.push_back(ScannedFile{FileInfo::metadata_only(fileName, _lazy_hash, _mmap_threshold),
+                                                  true, false, _lazy_hash});
+                    else
+                        out.push_back(ScannedFile{FileInfo(fileName, _mmap_threshold), false, false, true});
+                });
+        for (ScannedFile &file: scanned) {
+            ++_scan_stats.files;
+            if (file.read)
+                _scan_stats.bytes += file.info.size;
+            _scan_stats.restored += file.restored;
+            _scan_stats.stubs += file.stub;
+            file.stub ? add_file_stub(std::move(file.info)) : add_file_info(std::move(file.info));
+        }
+        _scan_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     }
 
 
@@ -134,6 +276,7 @@ public:
         for (auto &file: files) {
             _suffix_files.insert(file);
         }
+        compile_filter();
 
     }
 
@@ -154,46 +297,137 @@ public:
     }
 
 
+    /**
+     * 把每个文件的最新版本存进快照缓存, 下次启动时用来恢复基线
+     */
+    bool save_snapshot() const {
+        return !_snapshot_path.empty() && SnapshotCache::save(_snapshot_path, _files_versions);
+    }
+
     ~FileWatcher() {
-        for (auto &iterator: _files_versions) {
-            auto &files = iterator.second;
-            clear_files_version(files);
+        drain_changes();
+        save_snapshot();
+        for (auto &iterator: _pending_changes) {
+            PendingChange &pending = iterator.second;
+            if (pending.timer_inited)
+                close_handle(reinterpret_cast<uv_handle_t *>(&pending.timer));
         }
-        uv_stop(_loop);
-        uv_loop_close(_loop);
+#ifdef __linux__
+        if (_inotify) {
+            ++_handles_closing;
+            _inotify->stop([this] { --_handles_closing; });
+        }
+#endif
+        if (_fs_event)
+            close_handle(reinterpret_cast<uv_handle_t *>(_fs_event));
+        // 关闭回调跑完之前句柄还挂在事件循环上, 嵌在表里的计时器要等到这之后才能释放
+        while (_handles_closing > 0)
+            uv_run(_loop, UV_RUN_NOWAIT);
         delete _fs_event;
+        int status = uv_loop_close(_loop);
+        if (status < 0)
+            fprintf(stderr, "Error closing loop: %s\n", uv_strerror(status));
     }
 
 private:
-    template<typename Iterator>
-    void traverseDirectory(const std::filesystem::path &path) {
-        for (const auto &file: Iterator(path)) {
-            if (file.is_regular_file()) {
-                std::string fileName = file.path().lexically_normal();
-                std::string ext = get_suffix_fileName(fileName);
-                if (_suffix_files.find(ext) == _suffix_files.end())
-                    continue;
-                add_file_info(FileInfo(fileName));
-            }
-        }
+    /**
+     * 关闭句柄并计数, 关闭回调里减掉
+     */
+    void close_handle(uv_handle_t *handle) {
+        handle->data = this;
+        ++_handles_closing;
+        uv_close(handle, [](uv_handle_t *closed) {
+            --static_cast<FileWatcher *>(closed->data)->_handles_closing;
+        });
+    }
+
+    /**
+     * 析构前取消还在排队的任务, 等已经在跑的任务跑完回调,
+     * 之后工作线程不会再碰这个监听器和它的版本库
+     */
+    void drain_changes() {
+        _closing = true;
+        for (auto &iterator: _pending_changes)
+            if (iterator.second.job)
+                uv_cancel(reinterpret_cast<uv_req_t *>(&iterator.second.job->req));
+        while (_jobs_in_flight > 0)
+            uv_run(_loop, UV_RUN_ONCE);
     }
 
-    void add_file_info(const FileInfo &info) {
-        std::vector<FileInfo *> &files_ = _files_versions[info.fileName];
-        if (files_.size() > MAX_DIFF_SIZE) {
-            FileInfo *last = files_.back();
-            files_.pop_back();
-            clear_files_version(files_);
-            files_.push_back(last);
+    /**
+     * 存入新版本, delta 是从新版本还原上一版本的差量, 由工作线程预先算好
+     */
+    void add_file_info(FileInfo &&info, std::unique_ptr<VersionStore::Delta> delta = nullptr) {
+        // 保留 MAX_DIFF_SIZE 次变化, 即多一个版本
+        auto iterator = _files_versions.try_emplace(info.fileName, MAX_DIFF_SIZE + 1, _snapshot_every).first;
+        VersionStore &store = iterator->second;
+        size_t before = store.bytes();
+        store.push(std::move(info), std::move(delta));
+        store.last_used = ++_use_clock;
+        account(before, store);
+        enforce_memory_budget(&store);
+    }
+
+    /**
+     * 只存元数据, 等文件变化时再读内容
+     */
+    void add_file_stub(FileInfo &&info) {
+        auto iterator = _files_versions.try_emplace(info.fileName, MAX_DIFF_SIZE + 1, _snapshot_every).first;
+        VersionStore &store = iterator->second;
+        size_t before = store.bytes();
+        store.push(std::move(info));
+        store.evict();
+        account(before, store);
+    }
+
+    void account(size_t before, const VersionStore &store) {
+        _memory_used = _memory_used - before + store.bytes();
+    }
+
+    /**
+     * 超出内存上限时把最久没用的文件淘汰成存根, 一直淘汰到上限的 7/8,
+     * 留出余量, 免得每存一个版本都要扫一遍。正在处理的文件和刚存入的 keep 跳过,
+     * 刚算好的差异要靠 keep 里的版本展示。
+     */
+    void enforce_memory_budget(const VersionStore *keep) {
+        if (!_memory_budget || _memory_used <= _memory_budget)
+            return;
+        std::vector<std::pair<uint64_t, VersionStore *>> candidates;
+        for (auto &iterator: _files_versions) {
+            VersionStore &store = iterator.second;
+            if (store.stub() || &store == keep)
+                continue;
+            auto pending = _pending_changes.find(iterator.first);
+            if (pending != _pending_changes.end() && pending->second.running)
+                continue;
+            candidates.emplace_back(store.last_used, &store);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        size_t target = _memory_budget - _memory_budget / 8;
+        for (auto &candidate: candidates) {
+            if (_memory_used <= target)
+                break;
+            VersionStore &store = *candidate.second;
+            size_t before = store.bytes();
+            store.evict();
+            account(before, store);
+            ++_files_evicted;
         }
-        auto *inf = new FileInfo(info);
-        _files_versions[info.fileName].emplace_back(inf);
     }
 
-    static std::string get_suffix_fileName(const std::string &fileName) {
-        auto path = std::filesystem::path(fileName);
-        std::string pathFile = path.extension();
-        return pathFile.empty() ? pathFile : pathFile.substr(1);
+    /**
+     * 按当前的后缀和 glob 重新编译过滤器
+     */
+    void compile_filter() {
+        PathFilter filter(_dir);
+        filter.set_suffixes(std::vector<std::string>(_suffix_files.begin(), _suffix_files.end()));
+        for (const std::string &glob: _include_globs)
+            filter.add_include(glob);
+        for (const std::string &glob: _exclude_globs)
+            filter.add_exclude(glob);
+        if (_gitignore)
+            filter.load_gitignore((std::filesystem::path(_dir) / ".gitignore").string());
+        _filter = std::move(filter);
     }
 
     static void on_fs_event(uv_fs_event_t *handle, const char *filename, int events, int status) {
@@ -211,34 +445,196 @@ private:
             return;
         }
 
-        std::string suffix = get_suffix_fileName(filename);
-        if (_suffix_files.find(suffix) == _suffix_files.end())
-            return;
-        _now_changed_file = filename == "."s ? filename : _dir + "/" + filename;
+        std::string fileName = filename == "."s ? filename : _dir + "/" + filename;
 
         // ./
-        if (_now_changed_file.size() > 2)
-            if (_now_changed_file[0] == '.' && _now_changed_file[1] == '/')
-                _now_changed_file = _now_changed_file.substr(2);
+        if (fileName.size() > 2)
+            if (fileName[0] == '.' && fileName[1] == '/')
+                fileName = fileName.substr(2);
 
+        on_path_event(fileName);
+    }
 
-        add_file_info(FileInfo(_now_changed_file));
-        if (_show && !_files_versions.empty()) {
-            if (_print_callbacks.empty())
-                _print_callbacks.emplace_back(default_print_callback);
-            for (const auto &callback: _print_callbacks) {
-                callback(this);
-            }
+#ifdef __linux__
+
+    /**
+     * 只处理写完的文件时, 修改、新建、改属性这些中间事件只计数不处理;
+     * 删除和移走照常处理
+     */
+    void on_inotify_event(const std::string &fileName, uint32_t mask) {
+        if (_completed_writes && !(mask & (InotifyWatcher::COMPLETED_MASK | IN_DELETE | IN_MOVED_FROM))) {
+            ++_events_suppressed;
             return;
         }
+        on_path_event(fileName);
     }
 
+#endif
+
+    /**
+     * 不管事件来自 uv_fs_event 还是 inotify, 都按路径在这里处理
+     */
+    void on_path_event(const std::string &fileName) {
+        if (!_filter.accept_file(fileName))
+            return;
+        schedule_change(fileName);
+    }
 
-    static void clear_files_version(std::vector<FileInfo *> &files_version) {
-        for (const FileInfo *f: files_version) {
-            delete f;
+    /**
+     * 登记一次文件事件。
+     * 空闲时开始计静默期; 已在等待就把计时器往后推; 有任务在跑就等它跑完再计。
+     */
+    void schedule_change(const std::string &fileName) {
+        if (_closing)
+            return;
+        ++_events_received;
+        auto [iterator, inserted] = _pending_changes.try_emplace(fileName);
+        PendingChange &pending = iterator->second;
+        if (inserted) {
+            pending.watcher = this;
+            pending.fileName = &iterator->first;
         }
-        files_version.clear();
+        if (pending.running) {
+            if (pending.again)
+                ++_events_coalesced;
+            pending.again = true;
+            return;
+        }
+        if (pending.waiting)
+            ++_events_coalesced;
+        arm_change(pending);
     }
+
+    /**
+     * (重新)开始计静默期, 不需要合并时直接读
+     */
+    void arm_change(PendingChange &pending) {
+        if (_debounce_ms == 0) {
+            dispatch_change(pending);
+            return;
+        }
+        if (!pending.timer_inited) {
+            uv_timer_init(_loop, &pending.timer);
+            pending.timer.data = &pending;
+            pending.timer_inited = true;
+        }
+        pending.waiting = true;
+        uv_timer_start(&pending.timer, on_debounce_timer, _debounce_ms, 0);
+    }
+
+    static void on_debounce_timer(uv_timer_t *handle) {
+        auto *pending = static_cast<PendingChange *>(handle->data);
+        pending->waiting = false;
+        if (!pending->watcher->_closing)
+            pending->watcher->dispatch_change(*pending);
+    }
+
+    /**
+     * 静默期结束, 把文件交给线程池读取
+     */
+    void dispatch_change(PendingChange &pending) {
+        pending.running = true;
+        auto *job = new ChangeJob;
+        pending.job = job;
+        ++_jobs_in_flight;
+        job->req.data = job;
+        job->watcher = this;
+        const std::string &fileName = *pending.fileName;
+        job->fileName = fileName;
+        auto iterator = _files_versions.find(fileName);
+        bool stored = iterator != _files_versions.end() && !iterator->second.empty();
+        job->previous = stored ? &iterator->second.back() : nullptr;
+        job->previous_stub = stored && iterator->second.stub();
+        job->needs_delta = stored && iterator->second.needs_delta();
+        if (stored) {
+            VersionStore &store = iterator->second;
+            size_t before = store.bytes();
+            job->buffer = store.take_spare();
+            store.last_used = ++_use_clock;
+            account(before, store);
+        }
+        uv_queue_work(_loop, &job->req, on_change_work, on_change_done);
+    }
+
+    /**
+     * 工作线程: 读文件, 内容与上一版本相同就丢掉, 需要展示时顺便算好差异
+     */
+    static void on_change_work(uv_work_t *req) {
+        auto *job = static_cast<ChangeJob *>(req->data);
+        const FileInfo *previous = job->previous;
+        if (previous && job->watcher->_stat_precheck && previous->same_stat())
+            return;
+        // 原地改写的文件映射了也护不住旧版本, 有上一版本时只映射改名换上来的新文件
+        size_t mmap_threshold = previous && !previous->replaced() ? 0 : job->watcher->_mmap_threshold;
+        job->current = std::make_unique<FileInfo>(job->fileName, mmap_threshold, std::move(job->buffer));
+        if (previous && job->current->same_contents(*previous)) {
+            job->buffer = std::move(job->current->contents);
+            job->current.reset();
+            return;
+        }
+        if (previous && previous->mapping_overwritten()) {
+            job->previous_lost = true;
+            return;
+        }
+        bool show = job->watcher->_show && previous && !job->previous_stub;
+        if (!job->needs_delta && !show)
+            return;
+        // 差量和展示的差异出自同一次比较
+        LineComparison comparison(previous->data(), job->current->data());
+        if (job->needs_delta)
+            job->delta = VersionStore::make_delta(comparison);
+        if (show) {
+            dtl::UniHunkRenderer out;
+            comparison.render(out);
+            out.swapBuffer(job->diff);
+        }
+    }
+
+    static void on_change_done(uv_work_t *req, int status) {
+        std::unique_ptr<ChangeJob> job(static_cast<ChangeJob *>(req->data));
+        job->watcher->_on_change_done(*job, status);
+    }
+
+    /**
+     * 事件循环线程: 新版本入库, 回调展示, 期间有新事件就再计一次静默期
+     */
+    void _on_change_done(ChangeJob &job, int status) {
+        PendingChange &pending = _pending_changes.find(job.fileName)->second;
+        bool again = pending.again;
+        pending.running = false;
+        pending.again = false;
+        pending.job = nullptr;
+        --_jobs_in_flight;
+        if (status == 0 && !job.current)
+            ++_changes_unchanged;
+        // 没用上的缓冲区还给版本库
+        auto store = _files_versions.find(job.fileName);
+        if (store != _files_versions.end()) {
+            size_t before = store->second.bytes();
+            store->second.recycle(job.buffer);
+            account(before, store->second);
+        }
+        if (status == 0 && job.current) {
+            // 旧内容已经没了, 整个版本库降为存根, 新版本直接替换它
+            if (job.previous_lost && store != _files_versions.end()) {
+                size_t before = store->second.bytes();
+                store->second.evict();
+                account(before, store->second);
+            }
+            add_file_info(std::move(*job.current), std::move(job.delta));
+            _now_changed_file = job.fileName;
+            _now_changed_diff = std::move(job.diff);
+            if (_show && !_closing && !_files_versions.empty()) {
+                if (_print_callbacks.empty())
+                    _print_callbacks.emplace_back(default_print_callback);
+                for (const auto &callback: _print_callbacks) {
+                    callback(this);
+                }
+            }
+        }
+        if (again && !_closing)
+            arm_change(pending);
+    }
+
 };
 
@@ -0,0 +1,195 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/inotify.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+#include <uv.h>
+
+/**
+ * Linux 上的递归监听
+ * libuv 在 Linux 上忽略 UV_FS_EVENT_RECURSIVE, 只看顶层目录。
+ * 这里用一个 inotify fd 给每个目录加一个 watch, 通过 uv_poll_t 挂到事件循环上,
+ * 可读时一次 read() 取回一批事件; 新建或移入的子目录当场补上 watch。
+ * 回调收到的路径与 std::filesystem 遍历得到的 lexically_normal 路径一致。
+ */
+class InotifyWatcher {
+public:
+    using Callback = std::function<void(const std::string &path, uint32_t mask)>;
+    using DirFilter = std::function<bool(const std::string &dir)>;
+
+    // 与 libuv 的 uv_fs_event 在 Linux 上订阅的事件一致
+    static constexpr uint32_t DEFAULT_MASK = IN_ATTRIB | IN_CREATE | IN_MODIFY | IN_DELETE |
+                                             IN_MOVED_FROM | IN_MOVED_TO;
+    // 写完的事件: 写入后关闭, 或者先写临时文件再改名过来
+    static constexpr uint32_t COMPLETED_MASK = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+    InotifyWatcher(uv_loop_t *loop, uint32_t mask, Callback callback)
+            : _loop(loop), _mask(mask | IN_CREATE | IN_MOVED_TO), _callback(std::move(callback)) {}
+
+    InotifyWatcher(const InotifyWatcher &) = delete;
+
+    InotifyWatcher &operator=(const InotifyWatcher &) = delete;
+
+    ~InotifyWatcher() {
+        stop();
+    }
+
+    /**
+     * 给 root (recursive 时连同其下所有目录) 加 watch 并开始监听, 失败返回 libuv 风格的负错误码
+     */
+    int start(const std::string &root, bool recursive = true) {
+        _recursive = recursive;
+        _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0)
+            return -errno;
+        if (recursive)
+            watch_tree(root, false);
+        else
+            add_watch(root);
+        _poll = new uv_poll_t;
+        uv_poll_init(_loop, _poll, _fd);
+        _poll->data = this;
+        return uv_poll_start(_poll, UV_READABLE, on_readable);
+    }
+
+    /**
+     * 停止监听。句柄要等事件循环跑完关闭回调才释放, 这个对象可以马上销毁;
+     * 释放后调用 on_closed, 关闭事件循环前要等到它被调用
+     */
+    void stop(std::function<void()> on_closed = {}) {
+        if (_poll) {
+            _poll->data = new std::function<void()>(std::move(on_closed));
+            uv_close(reinterpret_cast<uv_handle_t *>(_poll), [](uv_handle_t *handle) {
+                auto *closed = static_cast<std::function<void()> *>(handle->data);
+                delete reinterpret_cast<uv_poll_t *>(handle);
+                if (*closed)
+                    (*closed)();
+                delete closed;
+            });
+            _poll = nullptr;
+        }
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        _dirs.clear();
+    }
+
+    /**
+     * 设置后 filter 返回 false 的目录不加 watch, 也不进入, 要在 start 之前设置
+     */
+    void set_dir_filter(DirFilter filter) {
+        _dir_filter = std::move(filter);
+    }
+
+    size_t watched_dirs() const {
+        return _dirs.size();
+    }
+
+private:
+    /**
+     * 给目录树加 watch, 不进入指向目录的符号链接。
+     * report 为真时把已经在里面的文件也报一遍: 新目录建好到加上 watch 之间写入的文件收不到事件。
+     * 这些文件当作移入处理, 还没写完的之后还会收到 IN_CLOSE_WRITE。
+     */
+    void watch_tree(const std::string &root, bool report) {
+        namespace fs = std::filesystem;
+        add_watch(root);
+        std::error_code ec;
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            std::error_code status;
+            if (it->is_directory(status) && !it->is_symlink(status)) {
+                std::string dir = it->path().lexically_normal().string();
+                if (_dir_filter && !_dir_filter(dir))
+                    it.disable_recursion_pending();
+                else
+                    add_watch(dir);
+            }
+            else if (report && it->is_regular_file(status))
+                _callback(it->path().lexically_normal().string(), IN_MOVED_TO);
+        }
+    }
+
+    void add_watch(const std::string &dir) {
+        int wd = ::inotify_add_watch(_fd, dir.c_str(), _mask | IN_ONLYDIR);
+        if (wd < 0) {
+            fprintf(stderr, "Error watching directory %s: %s\n", dir.c_str(), std::strerror(errno));
+            return;
+        }
+        _dirs[wd] = dir;
+    }
+
+    static void on_readable(uv_poll_t *handle, int status, int) {
+        auto *watcher = static_cast<InotifyWatcher *>(handle->data);
+        if (status < 0) {
+            fprintf(stderr, "Error watching file: %s\n", uv_strerror(status));
+            return;
+        }
+        watcher->read_events();
+    }
+
+    /**
+     * 一直读到 EAGAIN, 每次 read() 取回缓冲区能装下的所有事件
+     */
+    void read_events() {
+        for (;;) {
+            ssize_t n = ::read(_fd, _buffer, sizeof(_buffer));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                return;
+            }
+            for (char *p = _buffer; p < _buffer + n;) {
+                const auto *event = reinterpret_cast<const struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                dispatch(*event);
+            }
+        }
+    }
+
+    void dispatch(const struct inotify_event &event) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            fprintf(stderr, "inotify event queue overflowed, some changes were missed\n");
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            _dirs.erase(event.wd);
+            return;
+        }
+        auto dir = _dirs.find(event.wd);
+        if (dir == _dirs.end() || event.len == 0)
+            return;
+        std::string path = (std::filesystem::path(dir->second) / event.name).string();
+        if (event.mask & IN_ISDIR) {
+            if (_recursive && (event.mask & (IN_CREATE | IN_MOVED_TO)) &&
+                (!_dir_filter || _dir_filter(std::filesystem::path(path).lexically_normal().string())))
+                watch_tree(path, true);
+            return;
+        }
+        _callback(std::filesystem::path(path).lexically_normal().string(), event.mask);
+    }
+
+    uv_loop_t *_loop;
+    uint32_t _mask;
+    Callback _callback;
+    DirFilter _dir_filter;
+    bool _recursive = true;
+    int _fd = -1;
+    uv_poll_t *_poll = nullptr;                     // 关闭回调里释放
+    std::unordered_map<int, std::string> _dirs;     // watch 描述符到目录路径
+    alignas(struct inotify_event) char _buffer[1 << 16];
+};
+
+#endif
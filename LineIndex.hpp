@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "FastHash.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define LINE_INDEX_X86 1
+#endif
+
+/**
+ * 文件内容的行索引
+ * 只记录每一行在缓冲区里的起止偏移, 不复制内容。
+ * 行尾的 "\n" 不算在行内, 最后一行没有换行符时照样成行,
+ * 以换行符结尾的文件不会多出一个空行。line() 与 std::getline 切出的行逐字节一致,
+ * "\r\n" 结尾的行保留 '\r', 只在 "\n" 与 "\r\n" 之间转换也算改动。
+ */
+struct LineIndex {
+    std::string_view text;
+    std::vector<size_t> begins;
+    std::vector<size_t> ends;
+    std::vector<uint64_t> hashes;       // 每行内容的哈希, 只在建索引时要求了才有
+
+    size_t size() const {
+        return begins.size();
+    }
+
+    std::string_view line(size_t i) const {
+        return text.substr(begins[i], ends[i] - begins[i]);
+    }
+
+    /**
+     * 连同行尾换行符在内的整行, 依次拼接即可还原原始内容
+     */
+    std::string_view raw(size_t i) const {
+        size_t end = i + 1 < begins.size() ? begins[i + 1] : text.size();
+        return text.substr(begins[i], end - begins[i]);
+    }
+};
+
+namespace line_index {
+
+    /**
+     * 收到一个换行符的位置就登记一行, 顺便在行还在缓存里时算出哈希
+     */
+    struct Builder {
+        LineIndex &index;
+        bool with_hashes;
+        size_t begin = 0;
+
+        void line_end(size_t end) {
+            index.begins.push_back(begin);
+            index.ends.push_back(end);
+            if (with_hashes)
+                index.hashes.push_back(fast_hash64(index.text.data() + begin, end - begin));
+        }
+
+        void operator()(size_t newline) {
+            line_end(newline);
+            begin = newline + 1;
+        }
+
+        void finish() {
+            if (begin < index.text.size())
+                line_end(index.text.size());
+        }
+    };
+
+    template<typename F>
+    static void scan_scalar(const char *p, size_t from, size_t n, F &on_newline) {
+        const char *it = p + from;
+        const char *end = p + n;
+        while (it < end) {
+            const void *hit = std::memchr(it, '\n', static_cast<size_t>(end - it));
+            if (!hit)
+                break;
+            size_t pos = static_cast<const char *>(hit) - p;
+            on_newline(pos);
+            it = p + pos + 1;
+        }
+    }
+
+#ifdef LINE_INDEX_X86
+
+    template<typename F>
+    static void scan_sse2(const char *p, size_t n, F &on_newline) {
+        const __m128i nl = _mm_set1_epi8('\n');
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+            auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+            while (mask) {
+                on_newline(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        scan_scalar(p, i, n, on_newline);
+    }
+
+    template<typename F>
+    __attribute__((target("avx2")))
+    static void scan_avx2(const char *p, size_t n, F &on_newline) {
+        const __m256i nl = _mm256_set1_epi8('\n');
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+            while (mask) {
+                on_newline(i + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+        scan_scalar(p, i, n, on_newline);
+    }
+
+    static bool has_avx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+#endif
+}
+
+/**
+ * 扫描缓冲区建立行索引, x86 上按 CPU 能力选择 AVX2 或 SSE2, 其他平台走 memchr
+ */
+static LineIndex index_lines(std::string_view text, bool with_hashes = false) {
+    LineIndex index;
+    index.text = text;
+    line_index::Builder builder{index, with_hashes};
+#ifdef LINE_INDEX_X86
+    if (line_index::has_avx2())
+        line_index::scan_avx2(text.data(), text.size(), builder);
+    else
+        line_index::scan_sse2(text.data(), text.size(), builder);
+#else
+    line_index::scan_scalar(text.data(), 0, text.size(), builder);
+#endif
+    builder.finish();
+    return index;
+}
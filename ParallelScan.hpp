@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace parallel_scan {
+
+    /**
+     * 每个线程一个任务队列, 自己从尾部取, 别的线程空闲时从头部偷
+     */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::filesystem::directory_entry> items;
+
+        void push(std::filesystem::directory_entry entry) {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(entry));
+        }
+
+        bool pop(std::filesystem::directory_entry &entry) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (items.empty())
+                return false;
+            entry = std::move(items.back());
+            items.pop_back();
+            return true;
+        }
+
+        bool steal(std::filesystem::directory_entry &entry) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (items.empty())
+                return false;
+            entry = std::move(items.front());
+            items.pop_front();
+            return true;
+        }
+    };
+}
+
+/**
+ * 多线程遍历目录
+ * 目录和文件都是任务: 展开目录时把子项压进自己的队列, 普通文件交给 visit 处理,
+ * 队列空了就去别的线程那里偷, 一个大目录也能分摊到所有线程上。
+ * accept_dir(entry) 返回 false 的子目录整个跳过。
+ * visit(entry, out) 在工作线程里调用, 结果追加到本线程的 out, 最后按线程顺序拼接返回。
+ * 与 recursive_directory_iterator 一样, 不进入指向目录的符号链接。
+ */
+template<typename T, typename AcceptDir, typename Visit>
+static std::vector<T> parallel_scan_directory(const std::filesystem::path &root, bool recursive,
+                                              unsigned threads, AcceptDir accept_dir, Visit visit) {
+    namespace fs = std::filesystem;
+    using parallel_scan::WorkQueue;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<WorkQueue> queues(threads);
+    std::vector<std::vector<T>> results(threads);
+    std::atomic<size_t> outstanding{1};         // 已入队还没处理完的任务数
+    queues[0].push(fs::directory_entry(root));
+
+    auto expand = [&](const fs::directory_entry &dir, WorkQueue &queue) {
+        std::error_code ec;
+        fs::directory_iterator it(dir.path(), fs::directory_options::skip_permission_denied, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry &entry = *it;
+            std::error_code status;
+            bool wanted = entry.is_directory(status) && !entry.is_symlink(status)
+                          ? recursive && accept_dir(entry) : entry.is_regular_file(status);
+            if (!wanted)
+                continue;
+            outstanding.fetch_add(1);
+            queue.push(entry);
+        }
+    };
+
+    auto worker = [&](unsigned self) {
+        fs::directory_entry item;
+        while (outstanding.load() > 0) {
+            bool found = queues[self].pop(item);
+            for (unsigned i = 1; !found && i < threads; ++i)
+                found = queues[(self + i) % threads].steal(item);
+            if (!found) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::error_code ec;
+            if (item.is_directory(ec))
+                expand(item, queues[self]);
+            else
+                visit(item, results[self]);
+            outstanding.fetch_sub(1);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i)
+        pool.emplace_back(worker, i);
+    worker(0);
+    for (std::thread &thread: pool)
+        thread.join();
+
+    std::vector<T> merged = std::move(results[0]);
+    for (unsigned i = 1; i < threads; ++i)
+        std::move(results[i].begin(), results[i].end(), std::back_inserter(merged));
+    return merged;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * 编译好的路径过滤器
+ * 由监听的后缀、包含和排除的 glob 以及可选的根目录 .gitignore 组成, 只在配置变化时编译一次,
+ * 之后在 string_view 上匹配, 不分配内存。
+ *
+ * glob 的写法与 .gitignore 一致:
+ *   - 不含 '/' 的模式匹配任意一层的文件名或目录名, 如 "*.o"、"node_modules"
+ *   - 含 '/' 的模式相对监听的根目录匹配整条路径, 如 "/build"、"docs/tmp"
+ *   - 以 '/' 结尾的模式只匹配目录, 如 "build/"
+ *   - '*' 和 '?' 不跨 '/', "**" 可以跨, 支持 [a-z] 和 [!a-z]
+ *   - 排除规则以 '!' 开头表示重新包含, 后面的规则覆盖前面的
+ * 被排除的目录整个跳过, 不遍历也不监听, 其下的文件不能再被重新包含。
+ */
+class PathFilter {
+public:
+    PathFilter() = default;
+
+    explicit PathFilter(const std::string &root) {
+        set_root(root);
+    }
+
+    /**
+     * 设置监听的根目录, 路径先去掉它再与含 '/' 的模式比较
+     */
+    void set_root(const std::string &root) {
+        _root = std::filesystem::path(root).lexically_normal().string();
+        while (_root.size() > 1 && _root.back() == '/')
+            _root.pop_back();
+        if (_root == ".")
+            _root.clear();
+    }
+
+    void set_suffixes(const std::vector<std::string> &suffixes) {
+        _suffixes = suffixes;
+    }
+
+    void add_include(std::string_view glob) {
+        if (auto rule = compile(glob))
+            _includes.push_back(std::move(*rule));
+    }
+
+    void add_exclude(std::string_view glob) {
+        if (auto rule = compile(glob))
+            _excludes.push_back(std::move(*rule));
+    }
+
+    /**
+     * 把 .gitignore 的每一行当作排除规则追加, 文件不存在返回 false
+     */
+    bool load_gitignore(const std::string &path) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            add_exclude(line);
+        }
+        return true;
+    }
+
+    /**
+     * 目录是否要遍历和监听
+     */
+    bool accept_dir(std::string_view path) const {
+        std::string_view rel = relative(path);
+        return rel.empty() || !excluded_with_parents(rel, true);
+    }
+
+    /**
+     * 文件是否要处理: 后缀对得上, 满足包含规则, 自身和所在目录都没被排除。
+     * 与原来按后缀集合过滤一样, 没有设置后缀时不处理任何文件。
+     */
+    bool accept_file(std::string_view path) const {
+        std::string_view rel = relative(path);
+        if (!has_suffix(rel))
+            return false;
+        if (!_includes.empty()) {
+            bool included = false;
+            for (const Rule &rule: _includes)
+                if (matches(rule, rel)) {
+                    included = true;
+                    break;
+                }
+            if (!included)
+                return false;
+        }
+        return !excluded_with_parents(rel, false);
+    }
+
+private:
+    struct Rule {
+        std::string pattern;
+        bool negate = false;                    // '!' 开头, 重新包含
+        bool dir_only = false;                  // '/' 结尾, 只匹配目录
+        bool anchored = false;                  // 含 '/', 相对根目录匹配整条路径
+    };
+
+    static std::optional<Rule> compile(std::string_view glob) {
+        while (!glob.empty() && (glob.back() == ' ' || glob.back() == '\t'))
+            glob.remove_suffix(1);
+        if (glob.empty() || glob[0] == '#')
+            return std::nullopt;
+        Rule rule;
+        if (glob[0] == '!') {
+            rule.negate = true;
+            glob.remove_prefix(1);
+        } else if (glob[0] == '\\') {
+            glob.remove_prefix(1);              // "\#"、"\!" 开头的字面量
+        }
+        if (!glob.empty() && glob.back() == '/') {
+            rule.dir_only = true;
+            glob.remove_suffix(1);
+        }
+        if (!glob.empty() && glob[0] == '/') {
+            rule.anchored = true;
+            glob.remove_prefix(1);
+        }
+        if (glob.empty())
+            return std::nullopt;
+        rule.anchored = rule.anchored || glob.find('/') != std::string_view::npos;
+        rule.pattern = glob;
+        return rule;
+    }
+
+    std::string_view relative(std::string_view path) const {
+        if (_root.empty())
+            return path;
+        if (path.size() >= _root.size() && path.compare(0, _root.size(), _root) == 0) {
+            if (path.size() == _root.size())
+                return {};
+            if (path[_root.size()] == '/')
+                return path.substr(_root.size() + 1);
+        }
+        return path;
+    }
+
+    /**
+     * 与 std::filesystem::path::extension 一致: 文件名里最后一个 '.' 之后, 以 '.' 开头的文件名没有后缀
+     */
+    bool has_suffix(std::string_view rel) const {
+        std::string_view name = base_name(rel);
+        size_t dot = name.rfind('.');
+        std::string_view ext = dot == std::string_view::npos || dot == 0 ? std::string_view() : name.substr(dot + 1);
+        if (name == "." || name == "..")
+            ext = {};
+        for (const std::string &suffix: _suffixes)
+            if (ext == suffix)
+                return true;
+        return false;
+    }
+
+    static std::string_view base_name(std::string_view rel) {
+        size_t slash = rel.rfind('/');
+        return slash == std::string_view::npos ? rel : rel.substr(slash + 1);
+    }
+
+    /**
+     * 依次检查每一层父目录, 再检查自身; 任何一层父目录被排除, 其下一律排除
+     */
+    bool excluded_with_parents(std::string_view rel, bool is_dir) const {
+        if (_excludes.empty())
+            return false;
+        for (size_t slash = rel.find('/'); slash != std::string_view::npos; slash = rel.find('/', slash + 1))
+            if (excluded(rel.substr(0, slash), true))
+                return true;
+        return excluded(rel, is_dir);
+    }
+
+    bool excluded(std::string_view rel, bool is_dir) const {
+        bool result = false;
+        for (const Rule &rule: _excludes) {
+            if (rule.dir_only && !is_dir)
+                continue;
+            if (result != !rule.negate && matches(rule, rel))
+                result = !rule.negate;
+        }
+        return result;
+    }
+
+    static bool matches(const Rule &rule, std::string_view rel) {
+        return glob_match(rule.pattern, rule.anchored ? rel : base_name(rel));
+    }
+
+    /**
+     * 回溯匹配, 模式都很短, 不值得编译成自动机
+     */
+    static bool glob_match(std::string_view p, std::string_view s) {
+        while (!p.empty()) {
+            if (p.size() >= 2 && p[0] == '*' && p[1] == '*') {
+                std::string_view rest = p.substr(2);
+                if (!rest.empty() && rest[0] == '/') {
+                    // "**/" 匹配零层或多层目录
+                    rest.remove_prefix(1);
+                    if (glob_match(rest, s))
+                        return true;
+                    for (size_t i = s.find('/'); i != std::string_view::npos; i = s.find('/', i + 1))
+                        if (glob_match(rest, s.substr(i + 1)))
+                            return true;
+                    return false;
+                }
+                for (size_t i = 0; i <= s.size(); ++i)
+                    if (glob_match(rest, s.substr(i)))
+                        return true;
+                return false;
+            }
+            switch (p[0]) {
+                case '*': {
+                    std::string_view rest = p.substr(1);
+                    for (size_t i = 0;; ++i) {
+                        if (glob_match(rest, s.substr(i)))
+                            return true;
+                        if (i == s.size() || s[i] == '/')
+                            return false;
+                    }
+                }
+                case '?':
+                    if (s.empty() || s[0] == '/')
+                        return false;
+                    break;
+                case '[': {
+                    size_t close = p.find(']', 2);
+                    if (close == std::string_view::npos) {
+                        if (s.empty() || s[0] != '[')
+                            return false;
+                        break;
+                    }
+                    if (s.empty() || s[0] == '/' || !class_match(p.substr(1, close - 1), s[0]))
+                        return false;
+                    p.remove_prefix(close + 1);
+                    s.remove_prefix(1);
+                    continue;
+                }
+                case '\\':
+                    if (p.size() > 1)
+                        p.remove_prefix(1);
+                    [[fallthrough]];
+                default:
+                    if (s.empty() || s[0] != p[0])
+                        return false;
+                    break;
+            }
+            p.remove_prefix(1);
+            s.remove_prefix(1);
+        }
+        return s.empty();
+    }
+
+    static bool class_match(std::string_view set, char c) {
+        bool negate = !set.empty() && (set[0] == '!' || set[0] == '^');
+        if (negate)
+            set.remove_prefix(1);
+        bool found = false;
+        for (size_t i = 0; i < set.size(); ++i) {
+            if (i + 2 < set.size() && set[i + 1] == '-') {
+                found = found || (set[i] <= c && c <= set[i + 2]);
+                i += 2;
+            } else {
+                found = found || set[i] == c;
+            }
+        }
+        return found != negate;
+    }
+
+    std::string _root;
+    std::vector<std::string> _suffixes;
+    std::vector<Rule> _includes;
+    std::vector<Rule> _excludes;                // 配置的排除规则在前, .gitignore 在后
+};
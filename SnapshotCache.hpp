@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "FileInfo.hpp"
+#include "VersionStore.hpp"
+
+/**
+ * 磁盘上的快照缓存
+ * 保存每个文件最新版本的路径、大小、修改时间、哈希和内容, 重启时整个映射进来,
+ * 大小和修改时间都没变的文件直接用映射里的内容作基线, 不用再读。
+ * 文件布局: Header, Entry 数组, 路径表, 内容区, 偏移都从文件头算起, 按本机字节序存放。
+ * 保存时先写临时文件再改名, 旧快照的映射不受影响。
+ */
+class SnapshotCache {
+public:
+    /**
+     * 映射 path 指向的快照, 文件不存在或格式不对时得到一个空缓存
+     */
+    explicit SnapshotCache(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st{};
+        size_t length = ::fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+        void *addr = length >= sizeof(Header) ? ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            return;
+        auto mapping = std::make_shared<const MappedFile>(addr, length);
+        if (load(static_cast<const char *>(addr), length))
+            _mapping = std::move(mapping);
+        else
+            _entries.clear();
+    }
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+    /**
+     * info 是刚 stat 过的文件。快照里有它且大小、修改时间一致时补上哈希,
+     * 快照里存了内容的话让 info 指向映射里的内容并返回 true。
+     */
+    bool restore(FileInfo &info) const {
+        auto iterator = _entries.find(info.fileName);
+        if (iterator == _entries.end())
+            return false;
+        const Entry &entry = *iterator->second;
+        if (entry.size != info.size || entry.mtime != info.mtime)
+            return false;
+        info.hash = entry.hash;
+        info.hashed = true;
+        if (!(entry.flags & HAS_CONTENTS))
+            return false;
+        info.mapping = _mapping;
+        info.mapped = {static_cast<const char *>(_mapping->addr) + entry.content_offset,
+                       static_cast<size_t>(entry.content_length)};
+        return true;
+    }
+
+    /**
+     * 把每个文件的最新版本写进 path。存根只写元数据, 没有哈希的存根不写。
+     * 映射的文件已被原地改写的版本也只写元数据。
+     */
+    static bool save(const std::string &path, const std::unordered_map<std::string, VersionStore> &stores) {
+        std::vector<Entry> entries;
+        std::vector<const FileInfo *> infos;
+        uint64_t names = 0, contents = 0;
+        for (const auto &iterator: stores) {
+            const VersionStore &store = iterator.second;
+            if (store.empty())
+                continue;
+            const FileInfo &info = store.back();
+            if (store.stub() && !info.hashed)
+                continue;
+            Entry entry{};
+            entry.name_offset = names;
+            entry.name_length = static_cast<uint32_t>(iterator.first.size());
+            entry.flags = store.stub() || info.mapping_overwritten() ? 0 : HAS_CONTENTS;
+            entry.size = info.size;
+            entry.mtime = info.mtime;
+            entry.hash = info.hash;
+            entry.content_offset = contents;
+            entry.content_length = entry.flags & HAS_CONTENTS ? info.data().size() : 0;
+            names += entry.name_length;
+            contents += entry.content_length;
+            entries.push_back(entry);
+            infos.push_back(&info);
+        }
+
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+        header.count = entries.size();
+        header.names_offset = sizeof(Header) + entries.size() * sizeof(Entry);
+        header.contents_offset = header.names_offset + names;
+        for (Entry &entry: entries) {
+            entry.name_offset += header.names_offset;
+            entry.content_offset += header.contents_offset;
+        }
+
+        std::string temp = path + ".tmp";
+        std::FILE *fp = std::fopen(temp.c_str(), "wb");
+        if (!fp) {
+            fprintf(stderr, "Error writing snapshot %s\n", temp.c_str());
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                  (entries.empty() || std::fwrite(entries.data(), sizeof(Entry), entries.size(), fp) == entries.size());
+        for (size_t i = 0; ok && i < infos.size(); ++i)
+            ok = std::fwrite(infos[i]->fileName.data(), 1, entries[i].name_length, fp) == entries[i].name_length;
+        for (size_t i = 0; ok && i < infos.size(); ++i) {
+            std::string_view data = infos[i]->data();
+            ok = std::fwrite(data.data(), 1, entries[i].content_length, fp) == entries[i].content_length;
+        }
+        ok = std::fclose(fp) == 0 && ok;
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            fprintf(stderr, "Error writing snapshot %s\n", path.c_str());
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'U', 'V', 'F', 'S', 'S', 'N', 'P', '1'};
+    static constexpr uint32_t HAS_CONTENTS = 1;
+
+    struct Header {
+        char magic[8];
+        uint64_t count;
+        uint64_t names_offset;
+        uint64_t contents_offset;
+    };
+
+    struct Entry {
+        uint64_t name_offset;
+        uint32_t name_length;
+        uint32_t flags;
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash;
+        uint64_t content_offset;
+        uint64_t content_length;
+    };
+
+    /**
+     * 校验文件头和每个条目的范围, 建立路径到条目的索引
+     */
+    bool load(const char *base, size_t length) {
+        const auto *header = reinterpret_cast<const Header *>(base);
+        if (std::memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0)
+            return false;
+        if (header->count > (length - sizeof(Header)) / sizeof(Entry))
+            return false;
+        const auto *entries = reinterpret_cast<const Entry *>(base + sizeof(Header));
+        _entries.reserve(header->count);
+        for (uint64_t i = 0; i < header->count; ++i) {
+            const Entry &entry = entries[i];
+            if (entry.name_offset > length || entry.name_length > length - entry.name_offset ||
+                entry.content_offset > length || entry.content_length > length - entry.content_offset)
+                return false;
+            _entries.emplace(std::string_view(base + entry.name_offset, entry.name_length), &entry);
+        }
+        return true;
+    }
+
+    std::shared_ptr<const MappedFile> _mapping;
+    std::unordered_map<std::string_view, const Entry *> _entries;
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "FileInfo.hpp"
+#include "LineIndex.hpp"
+#include "unidiff.h"
+
+/**
+ * 一个文件的历史版本
+ * 最新版本保存完整内容, 较旧的版本只保存从后一个(更新的)版本还原它所需的反向差量,
+ * 需要时从最近的完整版本往回逐个打补丁还原。
+ * 每隔 snapshot_every 个版本保留一份完整内容, 还原最多回放 snapshot_every - 1 个差量。
+ * 超过 max_versions 个版本时丢掉最旧的一个, 差量都指向更新的版本, 丢掉最旧的不影响其他版本。
+ * 版本存放在环形缓冲区里, 存满后新版本直接覆盖最旧版本的槽, 淘汰是 O(1) 的。
+ * 降为差量或被覆盖的版本把内容缓冲区留作备用, 下一次读文件时拿去复用。
+ * 内存紧张时可以整个淘汰成存根, 只留最新版本的哈希、大小和修改时间,
+ * 还能判断内容有没有变, 但没有旧内容可比较了, 下一次 push 直接替换存根。
+ */
+class VersionStore {
+public:
+    using LineSeq = std::vector<std::string_view>;
+    using LineDiff = Diff<std::string_view, LineSeq>;
+    using LineEdit = std::pair<std::string_view, dtl::elemInfo>;
+
+    /**
+     * 把较新版本的行序列变回较旧版本的编辑, 只有增删没有公共行。
+     * 增加的行指向 added, 删除的行只用到下标。
+     * 只通过 unique_ptr 持有, added 建好后不再移动, 视图一直有效。
+     */
+    struct Delta {
+        std::string added;                      // 增加的行原文依次拼接
+        std::vector<LineEdit> edits;
+    };
+
+    uint64_t last_used = 0;                     // 最近一次使用的时刻, 由使用方维护, 用来按 LRU 淘汰
+
+    VersionStore(size_t max_versions, size_t snapshot_every)
+            : _max_versions(max_versions ? max_versions : 1), _snapshot_every(snapshot_every) {}
+
+    /**
+     * 计算从 newer 还原 older 的差量, 很耗时, 放在工作线程里算。
+     * 按带换行符的整行比较, 还原结果与原文逐字节一致。
+     */
+    static std::unique_ptr<Delta> make_delta(std::string_view newer, std::string_view older) {
+        return make_delta(LineComparison(older, newer));
+    }
+
+    /**
+     * 从 older 到 newer 的比较结果倒过来就是还原 older 的差量, 展示差异时算好的 SES 直接拿来用:
+     * 删掉的旧行变成增加, 增加的新行变成删除, 两边的下标对调。
+     */
+    static std::unique_ptr<Delta> make_delta(const LineComparison &comparison) {
+        const LineIndex &older = comparison.before;
+        auto delta = std::make_unique<Delta>();
+        const auto &ses = comparison.diff.getSesRef().getSequenceRef();
+        size_t added = 0, edits = 0;
+        for (const auto &e: ses) {
+            if (e.second.type == dtl::SES_DELETE)
+                added += older.raw(e.second.beforeIdx - 1).size();
+            if (e.second.type != dtl::SES_COMMON)
+                ++edits;
+        }
+        delta->added.reserve(added);
+        delta->edits.reserve(edits);
+        for (const auto &e: ses)
+            if (e.second.type == dtl::SES_DELETE)
+                delta->added += older.raw(e.second.beforeIdx - 1);
+        size_t offset = 0;
+        std::string_view text = delta->added;
+        for (const auto &e: ses) {
+            dtl::elemInfo reverse{e.second.afterIdx, e.second.beforeIdx, -e.second.type};
+            if (e.second.type == dtl::SES_DELETE) {
+                size_t length = older.raw(e.second.beforeIdx - 1).size();
+                delta->edits.emplace_back(text.substr(offset, length), reverse);
+                offset += length;
+            } else if (e.second.type == dtl::SES_ADD) {
+                delta->edits.emplace_back(std::string_view(), reverse);
+            }
+        }
+        return delta;
+    }
+
+    /**
+     * 下一次 push 时当前最新版本是否要降为差量, 是的话调用方应当先算好差量
+     */
+    bool needs_delta() const {
+        return !empty() && !_stub && !keeps_full(newest().seq);
+    }
+
+    /**
+     * 存入新的最新版本, delta 是从 info 还原当前最新版本的差量, 没给又需要时当场计算
+     */
+    void push(FileInfo &&info, std::unique_ptr<Delta> delta = nullptr) {
+        if (_stub) {
+            _ring.clear();
+            _head = 0;
+            _stub = false;
+        }
+        if (needs_delta()) {
+            Version &last = newest();
+            last.delta = delta ? std::move(delta) : make_delta(info.data(), last.info.data());
+            recycle(last.info.contents);
+            last.info.release_contents();
+        }
+        Version version{std::move(info), nullptr, _pushed++};
+        if (_ring.size() < _max_versions) {
+            // 还没存满时 _head 一直是 0, 直接追加
+            _ring.push_back(std::move(version));
+            return;
+        }
+        Version &oldest = _ring[_head];
+        recycle(oldest.info.contents);
+        oldest = std::move(version);
+        _head = (_head + 1) % _ring.size();
+    }
+
+    const FileInfo &back() const {
+        return newest().info;
+    }
+
+    size_t size() const {
+        return _ring.size();
+    }
+
+    bool empty() const {
+        return _ring.empty();
+    }
+
+    /**
+     * 是否只剩存根
+     */
+    bool stub() const {
+        return _stub;
+    }
+
+    /**
+     * 淘汰成存根: 丢掉所有内容、差量和备用缓冲区, 只留最新版本的元数据
+     */
+    void evict() {
+        if (empty())
+            return;
+        Version last{std::move(newest().info), nullptr, 0};
+        last.info.release_contents();
+        std::vector<Version>().swap(_ring);
+        _ring.push_back(std::move(last));
+        _head = 0;
+        std::string().swap(_spare);
+        _stub = true;
+    }
+
+    /**
+     * 所有版本、差量和备用缓冲区合计占用的内存
+     */
+    size_t bytes() const {
+        size_t total = _spare.capacity();
+        for (const Version &version: _ring) {
+            total += version.info.bytes();
+            if (version.delta)
+                total += version.delta->added.capacity() + version.delta->edits.capacity() * sizeof(LineEdit);
+        }
+        return total;
+    }
+
+    /**
+     * 收下一个用不着的缓冲区, 只留容量最大的一个
+     */
+    void recycle(std::string &buffer) {
+        if (buffer.capacity() > _spare.capacity())
+            _spare.swap(buffer);
+        std::string().swap(buffer);
+    }
+
+    /**
+     * 取走备用缓冲区, 没有时得到空串
+     */
+    std::string take_spare() {
+        std::string buffer;
+        buffer.swap(_spare);
+        return buffer;
+    }
+
+    /**
+     * 取第 i 个版本(0 是最旧的), 差量版本在这里还原出完整内容。
+     * 要读完整版本的内容, 调用前先确认映射的文件没被原地改写过, 见 FileInfo::mapping_overwritten。
+     */
+    FileInfo version(size_t i) const {
+        size_t full = i;
+        while (at(full).delta)
+            ++full;
+        if (full == i)
+            return at(i).info;
+
+        LineIndex index = index_lines(at(full).info.data());
+        LineSeq lines;
+        lines.reserve(index.size());
+        for (size_t k = 0; k < index.size(); ++k)
+            lines.push_back(index.raw(k));
+        while (full-- > i)
+            lines = LineDiff::patch(lines, at(full).delta->edits);
+
+        FileInfo info(at(i).info);
+        size_t length = 0;
+        for (std::string_view line: lines)
+            length += line.size();
+        info.contents.reserve(length);
+        for (std::string_view line: lines)
+            info.contents += line;
+        return info;
+    }
+
+private:
+    struct Version {
+        FileInfo info;                          // 差量版本只留元数据, 内容为空
+        std::unique_ptr<Delta> delta;           // 为空时 info 是完整内容
+        size_t seq;                             // 第几次存入
+    };
+
+    bool keeps_full(size_t seq) const {
+        return _snapshot_every && seq % _snapshot_every == 0;
+    }
+
+    const Version &at(size_t i) const {
+        return _ring[(_head + i) % _ring.size()];
+    }
+
+    const Version &newest() const {
+        return at(_ring.size() - 1);
+    }
+
+    Version &newest() {
+        return _ring[(_head + _ring.size() - 1) % _ring.size()];
+    }
+
+    std::vector<Version> _ring;                 // 从 _head 开始由旧到新, 最新版本总是完整
+    size_t _head = 0;                           // 最旧版本所在的槽
+    bool _stub = false;                         // 只剩最新版本的元数据
+    std::string _spare;                         // 备用的内容缓冲区
+    size_t _max_versions;
+    size_t _snapshot_every;
+    size_t _pushed = 0;
+};
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "dtl/Color.hpp"
+#include "dtl.hpp"
+
+
+using std::vector;
+using dtl::Diff;
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+/**
+ * 0..n-1 的行号序列, 每行都不一样
+ */
+static vector<uint32_t> numbered_lines(size_t n, uint32_t first = 0) {
+    vector<uint32_t> lines(n);
+    for (size_t i = 0; i < n; ++i)
+        lines[i] = first + static_cast<uint32_t>(i);
+    return lines;
+}
+
+/**
+ * deletesFirst 的 SES, 旧实现每个删除都插到变化段的中间, 要挪动段里已有的所有增加。
+ * 先往 Ses 里交替追加同一段里的删除和增加(整篇改写), 再对隔行改写的文件走一遍完整的 patience 比较。
+ * 行数翻倍时耗时也应当只翻倍。
+ */
+static void bench_ses() {
+    printf("deletes-first SES: one run of n deletes and n adds, then a file with every other line rewritten\n");
+    printf("%10s %14s %14s %14s\n", "lines", "Ses seconds", "diff seconds", "diff ns/line");
+    for (size_t n: {25000, 50000, 100000}) {
+        auto start = bench_clock::now();
+        dtl::Ses<uint32_t> ses(true);
+        for (size_t i = 0; i < n; ++i) {
+            ses.addSequence(static_cast<uint32_t>(i), static_cast<long long>(i) + 1, 0, dtl::SES_DELETE);
+            ses.addSequence(static_cast<uint32_t>(n + i), 0, static_cast<long long>(i) + 1, dtl::SES_ADD);
+        }
+        ses.getSequenceRef();
+        double ses_seconds = seconds_since(start);
+
+        vector<uint32_t> a = numbered_lines(n);
+        vector<uint32_t> b = a;
+        for (size_t i = 1; i < n; i += 2)
+            b[i] = static_cast<uint32_t>(n + i);
+        start = bench_clock::now();
+        Diff<uint32_t> diff(std::move(a), std::move(b), true);
+        diff.compose(dtl::DTL_ALGORITHM_PATIENCE);
+        diff.getSesRef().getSequenceRef();
+        double diff_seconds = seconds_since(start);
+        printf("%10zu %14.3f %14.3f %14.1f\n", n, ses_seconds, diff_seconds, diff_seconds * 1e9 / n);
+    }
+    printf("\n");
+}
+
+/**
+ * 模拟生成的源文件: 大部分行各不相同, 每 8 行夹一行 "}" 之类的公共行
+ */
+static vector<uint32_t> generated_lines(size_t n) {
+    vector<uint32_t> lines = numbered_lines(n, 16);
+    for (size_t i = 7; i < n; i += 8)
+        lines[i] = static_cast<uint32_t>(i / 8 % 16);
+    return lines;
+}
+
+/**
+ * 把 rate 比例的行换成新行, 固定种子, 每次跑的输入一样
+ */
+static vector<uint32_t> rewrite_lines(const vector<uint32_t> &lines, double rate) {
+    vector<uint32_t> result = lines;
+    uint32_t seed = 12345;
+    uint32_t fresh = static_cast<uint32_t>(lines.size()) + 16;
+    for (uint32_t &line: result) {
+        seed = seed * 1103515245u + 12345u;
+        if ((seed >> 8) % 10000 < rate * 10000)
+            line = fresh++;
+    }
+    return result;
+}
+
+static double time_compose(const vector<uint32_t> &a, const vector<uint32_t> &b, dtl::algorithm_t algorithm,
+                           long long &edit_distance) {
+    auto start = bench_clock::now();
+    Diff<uint32_t> diff(a, b);
+    diff.onHuge();
+    diff.compose(algorithm);
+    diff.getSesRef().getSequenceRef();
+    edit_distance = diff.getEditDistance();
+    return seconds_since(start);
+}
+
+/**
+ * patience 与 O(NP) 对比: O(NP) 的耗时随差异数 P 增长, patience 只锚定唯一行再递归到空隙里。
+ * patience 不保证最短, 顺带打印两边的编辑距离。最后单独看整篇改写时 patience 是否线性。
+ */
+static void bench_patience() {
+    const size_t n = 40000;
+    vector<uint32_t> a = generated_lines(n);
+    printf("patience vs O(NP), %zu lines\n", n);
+    printf("%10s %12s %12s %12s %12s\n", "changed", "O(NP) s", "O(NP) edits", "patience s", "pat. edits");
+    for (double rate: {0.001, 0.01, 0.1, 0.3, 1.0}) {
+        vector<uint32_t> b = rewrite_lines(a, rate);
+        long long onp_edits = 0, patience_edits = 0;
+        double onp = time_compose(a, b, dtl::DTL_ALGORITHM_ONP, onp_edits);
+        double patience = time_compose(a, b, dtl::DTL_ALGORITHM_PATIENCE, patience_edits);
+        printf("%9.1f%% %12.3f %12lld %12.3f %12lld\n", rate * 100, onp, onp_edits, patience, patience_edits);
+    }
+    printf("\n");
+
+    printf("patience, full rewrite\n");
+    printf("%10s %12s %14s\n", "lines", "seconds", "ns/line");
+    for (size_t lines: {25000, 50000, 100000}) {
+        vector<uint32_t> before = generated_lines(lines);
+        vector<uint32_t> after = numbered_lines(lines, static_cast<uint32_t>(lines) + 16);
+        long long edits = 0;
+        double seconds = time_compose(before, after, dtl::DTL_ALGORITHM_PATIENCE, edits);
+        printf("%10zu %12.3f %14.1f\n", lines, seconds, seconds * 1e9 / lines);
+    }
+    printf("\n");
+}
+
+/* diff benchmark: diff_bench [all|ses|patience] */
+int main(int argc, char **argv) {
+    const char *which = argc > 1 ? argv[1] : "all";
+    bool all = std::strcmp(which, "all") == 0;
+    if (all || std::strcmp(which, "ses") == 0)
+        bench_ses();
+    if (all || std::strcmp(which, "patience") == 0)
+        bench_patience();
+    return 0;
+}
@@ -50,7 +50,7 @@ namespace dtl {
 
 
     void resetColor(std::ostream &os) {
-        std::cout << "\033[0m";
+        os << "\033[0m";
     }
 
 }
\ No newline at end of file
@@ -58,12 +58,16 @@ namespace dtl {
         long long editDistance;
         Lcs<elem> lcs;
         Ses<elem> ses;
-        editPath path;
-        editPathCordinates pathCordinates;
+        DiffWorkspace localWork;
+        DiffWorkspace *sharedWork;
+        DiffWorkspace *work;
+        long long vOffset;
         bool swapped;
         bool huge;
         bool trivial;
+        bool trimming;
         bool editDistanceOnly;
+        algorithm_t algorithm;
         uniHunkVec uniHunks;
         comparator cmp;
         long long ox;
@@ -83,6 +87,20 @@ namespace dtl {
             init();
         }
 
+        /**
+         * take over the sequences instead of copying them
+         */
+        Diff(sequence &&a,
+             sequence &&b) : A(std::move(a)), B(std::move(b)), ses(false) {
+            init();
+        }
+
+        Diff(sequence &&a,
+             sequence &&b,
+             bool deletesFirst) : A(std::move(a)), B(std::move(b)), ses(deletesFirst) {
+            init();
+        }
+
         Diff(const sequence &a,
              const sequence &b,
              const comparator &comp) : A(a), B(b), ses(false), cmp(comp) {
@@ -99,6 +117,14 @@ namespace dtl {
         ~Diff() {}
 
 
+        /**
+         * compose with the buffers of the given workspace instead of fresh ones,
+         * pass NULL to go back to the buffers owned by this Diff
+         */
+        void setWorkspace(DiffWorkspace *w) {
+            sharedWork = w;
+        }
+
         void set_print_callback(std::function<void(uniHunk<sesElem>)> callback) {
             print_callback = callback;
         }
@@ -123,6 +149,21 @@ namespace dtl {
             return uniHunks;
         }
 
+        /**
+         * non-copying access, valid while this Diff lives and is not composed again
+         */
+        const Lcs<elem> &getLcsRef() const {
+            return lcs;
+        }
+
+        const Ses<elem> &getSesRef() const {
+            return ses;
+        }
+
+        const uniHunkVec &getUniHunksRef() const {
+            return uniHunks;
+        }
+
         /* These should be deprecated */
         bool isHuge() const {
             return huge;
@@ -181,79 +222,124 @@ namespace dtl {
             this->editDistanceOnly = true;
         }
 
+        /**
+         * strip the common head before the O(NP) search.
+         * The tail is left to the search: trimming it greedily can pick a
+         * different, equally short alignment and move the hunks.
+         */
+        bool trimmingEnabled() const {
+            return trimming;
+        }
+
+        void enableTrimming() {
+            this->trimming = true;
+        }
+
+        void disableTrimming() {
+            this->trimming = false;
+        }
+
+        /**
+         * select the algorithm compose() runs, DTL_ALGORITHM_ONP by default
+         */
+        algorithm_t getAlgorithm() const {
+            return algorithm;
+        }
+
+        void setAlgorithm(algorithm_t algo) {
+            this->algorithm = algo;
+        }
+
         /**
          * patching with Unified Format Hunks
+         * One forward pass: lines between hunks and common lines are copied
+         * in runs from seq into an output allocated once.
          */
-        sequence uniPatch(const sequence &seq) {
-            elemList seqLst(seq.begin(), seq.end());
-            sesElemVec shunk;
-            sesElemVec_iter vsesIt;
-            elemList_iter lstIt = seqLst.begin();
-            long long inc_dec_total = 0;
-            long long gap = 1;
-            for (uniHunkVec_iter it = uniHunks.begin(); it != uniHunks.end(); ++it) {
-                joinSesVec(shunk, it->common[0]);
-                joinSesVec(shunk, it->change);
-                joinSesVec(shunk, it->common[1]);
-                it->a += inc_dec_total;
-                inc_dec_total += it->inc_dec_count;
-                for (long long i = 0; i < it->a - gap; ++i) {
-                    ++lstIt;
-                }
-                gap = it->a + it->b + it->inc_dec_count;
-                vsesIt = shunk.begin();
-                while (vsesIt != shunk.end()) {
-                    switch (vsesIt->second.type) {
-                        case SES_ADD :
-                            seqLst.insert(lstIt, vsesIt->first);
-                            break;
-                        case SES_DELETE :
-                            if (lstIt != seqLst.end()) {
-                                lstIt = seqLst.erase(lstIt);
-                            }
-                            break;
-                        case SES_COMMON :
-                            if (lstIt != seqLst.end()) {
-                                ++lstIt;
-                            }
-                            break;
-                        default :
-                            // no fall-through
-                            break;
-                    }
-                    ++vsesIt;
+        sequence uniPatch(const sequence &seq) const {
+            long long patchedSize = static_cast<long long>(seq.size());
+            for (size_t i = 0; i < uniHunks.size(); ++i) {
+                patchedSize += uniHunks[i].inc_dec_count;
+            }
+            sequence patchedSeq;
+            patchedSeq.reserve((size_t) max(patchedSize, 0LL));
+            size_t pos = 0;
+            for (size_t i = 0; i < uniHunks.size(); ++i) {
+                const uniHunk<sesElem> &hunk = uniHunks[i];
+                size_t start = (size_t) max(hunk.a - 1, 0LL);
+                if (start > seq.size()) start = seq.size();
+                if (start > pos) {
+                    patchedSeq.insert(patchedSeq.end(), seq.begin() + pos, seq.begin() + start);
+                    pos = start;
                 }
-                shunk.clear();
+                applySes(seq, pos, hunk.common[0], patchedSeq);
+                applySes(seq, pos, hunk.change, patchedSeq);
+                applySes(seq, pos, hunk.common[1], patchedSeq);
             }
-
-            sequence patchedSeq(seqLst.begin(), seqLst.end());
+            patchedSeq.insert(patchedSeq.end(), seq.begin() + pos, seq.end());
             return patchedSeq;
         }
 
         /**
          * patching with Shortest Edit Script (SES)
+         * One forward pass like uniPatch.
          */
         sequence patch(const sequence &seq) const {
-            sesElemVec sesSeq = ses.getSequence();
-            elemList seqLst(seq.begin(), seq.end());
-            elemList_iter lstIt = seqLst.begin();
-            for (sesElemVec_iter sesIt = sesSeq.begin(); sesIt != sesSeq.end(); ++sesIt) {
+            const sesElemVec &sesSeq = ses.getSequenceRef();
+            long long patchedSize = static_cast<long long>(seq.size());
+            for (sesElemVec_const_iter sesIt = sesSeq.begin(); sesIt != sesSeq.end(); ++sesIt) {
+                patchedSize += sesIt->second.type; // SES_ADD is 1, SES_DELETE is -1
+            }
+            sequence patchedSeq;
+            patchedSeq.reserve((size_t) max(patchedSize, 0LL));
+            size_t pos = 0;
+            applySes(seq, pos, sesSeq, patchedSeq);
+            patchedSeq.insert(patchedSeq.end(), seq.begin() + pos, seq.end());
+            return patchedSeq;
+        }
+
+        /**
+         * patching with a sparse edit script
+         * Only SES_ADD and SES_DELETE elements are needed, in SES order:
+         * deleted elements are located by beforeIdx and added ones by afterIdx,
+         * so commons can be dropped from a stored script. Commons that are
+         * present are ignored.
+         */
+        static sequence patch(const sequence &seq, const sesElemVec &edits) {
+            long long patchedSize = static_cast<long long>(seq.size());
+            for (sesElemVec_const_iter sesIt = edits.begin(); sesIt != edits.end(); ++sesIt) {
+                if (sesIt->second.type != SES_COMMON) {
+                    patchedSize += sesIt->second.type;
+                }
+            }
+            sequence patchedSeq;
+            patchedSeq.reserve((size_t) max(patchedSize, 0LL));
+            size_t pos = 0;
+            for (sesElemVec_const_iter sesIt = edits.begin(); sesIt != edits.end(); ++sesIt) {
                 switch (sesIt->second.type) {
-                    case SES_ADD :
-                        seqLst.insert(lstIt, sesIt->first);
-                        break;
-                    case SES_DELETE :
-                        lstIt = seqLst.erase(lstIt);
+                    case SES_ADD : {
+                        size_t at = (size_t) max(sesIt->second.afterIdx - 1, 0LL);
+                        if (at > patchedSeq.size()) {
+                            copyCommons(seq, pos, at - patchedSeq.size(), patchedSeq);
+                        }
+                        patchedSeq.push_back(sesIt->first);
                         break;
-                    case SES_COMMON :
-                        ++lstIt;
+                    }
+                    case SES_DELETE : {
+                        size_t at = (size_t) max(sesIt->second.beforeIdx - 1, 0LL);
+                        if (at > pos) {
+                            copyCommons(seq, pos, at - pos, patchedSeq);
+                        }
+                        if (pos < seq.size()) {
+                            ++pos;
+                        }
                         break;
+                    }
                     default :
                         // no through
                         break;
                 }
             }
-            sequence patchedSeq(seqLst.begin(), seqLst.end());
+            patchedSeq.insert(patchedSeq.end(), seq.begin() + pos, seq.end());
             return patchedSeq;
         }
 
@@ -264,16 +350,31 @@ namespace dtl {
          */
         void compose() {
 
-            if (isHuge()) {
-                pathCordinates.reserve(MAX_CORDINATES_SIZE);
+            if (algorithm == DTL_ALGORITHM_LINEAR_SPACE) {
+                composeLinearSpace();
+                return;
+            }
+            if (algorithm == DTL_ALGORITHM_PATIENCE) {
+                composePatience();
+                return;
+            }
+
+            work = sharedWork ? sharedWork : &localWork;
+            work->pathCordinates.clear();
+            work->epc.clear();
+            // a shared workspace outlives this Diff, reserving the cap up front would pin it there
+            if (isHuge() && !sharedWork) {
+                work->pathCordinates.reserve(MAX_CORDINATES_SIZE);
             }
             ox = 0;
             oy = 0;
+            if (trimmingEnabled()) {
+                trimCommonPrefix();
+            }
             long long p = -1;
-            fp = new long long[M + N + 3];
-            fill(&fp[0], &fp[M + N + 3], -1);
-            path = editPath(M + N + 3);
-            fill(path.begin(), path.end(), -1);
+            work->fp.assign(M + N + 3, -1);
+            fp = work->fp.data();
+            work->path.assign(M + N + 3, -1);
             ONP:
             do {
                 ++p;
@@ -285,34 +386,79 @@ namespace dtl {
                 }
                 fp[delta + offset] = snake(static_cast<long long>(delta), fp[delta - 1 + offset] + 1,
                                            fp[delta + 1 + offset]);
-            } while (fp[delta + offset] != static_cast<long long>(N) && pathCordinates.size() < MAX_CORDINATES_SIZE);
+            } while (fp[delta + offset] != static_cast<long long>(N) &&
+                     work->pathCordinates.size() < MAX_CORDINATES_SIZE);
 
             editDistance += static_cast<long long>(delta) + 2 * p;
-            long long r = path[delta + offset];
+            long long r = work->path[delta + offset];
             P cordinate;
-            editPathCordinates epc(0);
+            editPathCordinates &epc = work->epc;
 
             // recording edit distance only
             if (editDistanceOnly) {
-                delete[] this->fp;
                 return;
             }
 
             while (r != -1) {
-                cordinate.x = pathCordinates[(size_t) r].x;
-                cordinate.y = pathCordinates[(size_t) r].y;
+                cordinate.x = work->pathCordinates[(size_t) r].x;
+                cordinate.y = work->pathCordinates[(size_t) r].y;
                 epc.push_back(cordinate);
-                r = pathCordinates[(size_t) r].k;
+                r = work->pathCordinates[(size_t) r].k;
             }
 
             // record Longest Common Subsequence & Shortest Edit Script
             if (!recordSequence(epc)) {
-                pathCordinates.resize(0);
+                work->pathCordinates.resize(0);
                 epc.resize(0);
                 p = -1;
                 goto ONP;
             }
-            delete[] this->fp;
+
+        }
+
+        /**
+         * compose Longest Common Subsequence and Shortest Edit Script in linear space.
+         * The algorithm implemented here is the divide and conquer on middle snakes
+         * described in "An O(ND) Difference Algorithm and Its Variations" by Eugene W. Myers.
+         * Only the two V vectors are kept, so memory stays O(M + N) and the SES is still minimal.
+         */
+        void composeLinearSpace() {
+            ox = 0;
+            oy = 0;
+            size_t dmax = (M + N + 1) / 2 + 1;
+            vOffset = (long long) dmax + 1;
+            work = sharedWork ? sharedWork : &localWork;
+            work->vf.assign(2 * dmax + 3, -1);
+            work->vb.assign(2 * dmax + 3, -1);
+            composeBox(0, 0, (long long) M, (long long) N);
+        }
+
+        /**
+         * compose with the given algorithm instead of the one set on this Diff
+         */
+        void compose(algorithm_t algo) {
+            setAlgorithm(algo);
+            compose();
+        }
+
+        /**
+         * compose Shortest Edit Script with patience diff.
+         * Elements occurring exactly once in both windows are matched as anchors,
+         * the longest increasing run of anchors is kept and only the gaps between
+         * them are searched further, falling back to the linear space algorithm
+         * for gaps without unique elements. The result is not necessarily minimal,
+         * but its cost does not grow with the number of differences.
+         * elem must be hashable by std::hash and comparator must agree with operator==.
+         */
+        void composePatience() {
+            ox = 0;
+            oy = 0;
+            size_t dmax = (M + N + 1) / 2 + 1;
+            vOffset = (long long) dmax + 1;
+            work = sharedWork ? sharedWork : &localWork;
+            work->vf.assign(2 * dmax + 3, -1);
+            work->vb.assign(2 * dmax + 3, -1);
+            composePatienceBox(0, 0, (long long) M, (long long) N);
         }
 
         /**
@@ -320,7 +466,7 @@ namespace dtl {
          */
         template<typename stream>
         void printSES(stream &out) const {
-            sesElemVec ses_v = ses.getSequence();
+            const sesElemVec &ses_v = ses.getSequenceRef();
             for_each(ses_v.begin(), ses_v.end(), ChangePrinter<sesElem, stream>(out));
         }
 
@@ -333,7 +479,7 @@ namespace dtl {
          */
         template<typename stream>
         static void printSES(const Ses<elem> &s, stream &out) {
-            sesElemVec ses_v = s.getSequence();
+            const sesElemVec &ses_v = s.getSequenceRef();
             for_each(ses_v.begin(), ses_v.end(), ChangePrinter<sesElem, stream>(out));
         }
 
@@ -346,7 +492,7 @@ namespace dtl {
          */
         template<typename stream, template<typename SEET, typename STRT> class PT>
         void printSES(stream &out) const {
-            sesElemVec ses_v = ses.getSequence();
+            const sesElemVec &ses_v = ses.getSequenceRef();
             for_each(ses_v.begin(), ses_v.end(), PT<sesElem, stream>(out));
         }
 
@@ -355,7 +501,7 @@ namespace dtl {
          */
         template<typename storedData, template<typename SEET, typename STRT> class ST>
         void storeSES(storedData &sd) const {
-            sesElemVec ses_v = ses.getSequence();
+            const sesElemVec &ses_v = ses.getSequenceRef();
             for_each(ses_v.begin(), ses_v.end(), ST<sesElem, storedData>(sd));
         }
 
@@ -393,9 +539,77 @@ namespace dtl {
          * compose Unified Format Hunks from Shortest Edit Script
          */
         void composeUnifiedHunks() {
+            HunkStorage store(uniHunks);
+            composeHunks(store);
+        }
+
+        /**
+         * compose Unified Format Hunks and hand each one to emit as soon as it is closed.
+         * Nothing is stored in this Diff, so getUniHunks() and uniPatch() do not see them.
+         */
+        template<typename sink>
+        void composeUnifiedHunks(sink emit) {
+            HunkForwarder<sink> forward(emit);
+            composeHunks(forward);
+        }
+
+        /**
+         * stream the Unified Format to print_callback if set, to out otherwise
+         */
+        template<typename stream>
+        void streamUnifiedFormat(stream &out) {
+            if (print_callback) {
+                composeUnifiedHunks(print_callback);
+                return;
+            }
+            composeUnifiedHunks(UniHunkPrinter<sesElem, stream>(out));
+        }
+
+        void streamUnifiedFormat(ostream &out = cout) {
+            streamUnifiedFormat<ostream>(out);
+        }
+
+    private :
+        /**
+         * keep closed hunks in uniHunks
+         */
+        class HunkStorage {
+        public :
+            HunkStorage(uniHunkVec &hunks) : hunks_(hunks) {}
+
+            void operator()(uniHunk<sesElem> &hunk) const {
+                hunks_.push_back(std::move(hunk));
+            }
+
+        private :
+            uniHunkVec &hunks_;
+        };
+
+        /**
+         * pass closed hunks on to a user sink
+         */
+        template<typename sink>
+        class HunkForwarder {
+        public :
+            HunkForwarder(sink &emit) : emit_(emit) {}
+
+            void operator()(uniHunk<sesElem> &hunk) const {
+                emit_(static_cast<const uniHunk<sesElem> &>(hunk));
+            }
+
+        private :
+            sink &emit_;
+        };
+
+        /**
+         * walk the SES once and emit every hunk when it closes.
+         * The buffers of a hunk are handed over, not copied, and reused for the next one.
+         */
+        template<typename emitter>
+        void composeHunks(emitter &emit) {
             sesElemVec common[2];
             sesElemVec change;
-            sesElemVec ses_v = ses.getSequence();
+            const sesElemVec &ses_v = ses.getSequenceRef();
             long long l_cnt = 1;
             long long length = distance(ses_v.begin(), ses_v.end());
             long long middle = 0;
@@ -410,7 +624,7 @@ namespace dtl {
             isMiddle = isAfter = false;
             a = b = c = d = 0;
 
-            for (sesElemVec_iter it = ses_v.begin(); it != ses_v.end(); ++it, ++l_cnt) {
+            for (sesElemVec_const_iter it = ses_v.begin(); it != ses_v.end(); ++it, ++l_cnt) {
                 einfo = it->second;
                 switch (einfo.type) {
                     case SES_ADD :
@@ -480,7 +694,7 @@ namespace dtl {
                 }
                 // compose unified format hunk
                 if (isAfter && !change.empty()) {
-                    sesElemVec_iter cit = it;
+                    sesElemVec_const_iter cit = it;
                     long long cnt = 0;
                     for (long long i = 0; i < DTL_SEPARATE_SIZE && (cit != ses_v.end()); ++i, ++cit) {
                         if (cit->second.type == SES_COMMON) {
@@ -510,23 +724,28 @@ namespace dtl {
                     hunk.b = b;
                     hunk.c = c;
                     hunk.d = d;
-                    hunk.common[0] = common[0];
-                    hunk.change = change;
-                    hunk.common[1] = common[1];
+                    hunk.common[0].swap(common[0]);
+                    hunk.change.swap(change);
+                    hunk.common[1].swap(common[1]);
                     hunk.inc_dec_count = inc_dec_count;
-                    uniHunks.push_back(hunk);
+                    emit(hunk);
                     isMiddle = false;
                     isAfter = false;
-                    common[0].clear();
-                    common[1].clear();
+                    hunk.common[0].clear();
+                    hunk.change.clear();
+                    hunk.common[1].clear();
+                    common[0].swap(hunk.common[0]);
+                    change.swap(hunk.change);
+                    common[1].swap(hunk.common[1]);
                     adds.clear();
                     deletes.clear();
-                    change.clear();
                     a = b = c = d = middle = inc_dec_count = 0;
                 }
             }
         }
 
+    public :
+
         /**
          * compose ses from stream
          */
@@ -573,30 +792,34 @@ namespace dtl {
             offset = M + 1;
             huge = false;
             trivial = false;
+            trimming = false;
             editDistanceOnly = false;
+            algorithm = DTL_ALGORITHM_ONP;
             fp = NULL;
+            sharedWork = NULL;
+            work = NULL;
         }
 
         /**
          * search shortest path and record the path
          */
         long long snake(const long long &k, const long long &above, const long long &below) {
+            editPath &path = work->path;
             long long r = above > below ? path[(size_t) k - 1 + offset] : path[(size_t) k + 1 + offset];
             long long y = max(above, below);
             long long x = y - k;
-            while ((size_t) x < M && (size_t) y < N &&
-                   (swapped ? cmp.impl(B[(size_t) y], A[(size_t) x]) : cmp.impl(A[(size_t) x], B[(size_t) y]))) {
+            while ((size_t) x < M && (size_t) y < N && equals(ox + (size_t) x, oy + (size_t) y)) {
                 ++x;
                 ++y;
             }
 
-            path[(size_t) k + offset] = static_cast<long long>(pathCordinates.size());
+            path[(size_t) k + offset] = static_cast<long long>(work->pathCordinates.size());
             if (!editDistanceOnly) {
                 P p;
                 p.x = x;
                 p.y = y;
                 p.k = r;
-                pathCordinates.push_back(p);
+                work->pathCordinates.push_back(p);
             }
             return y;
         }
@@ -605,8 +828,8 @@ namespace dtl {
          * record SES and LCS
          */
         bool recordSequence(const editPathCordinates &v) {
-            sequence_const_iter x(A.begin());
-            sequence_const_iter y(B.begin());
+            sequence_const_iter x(A.begin() + ox);
+            sequence_const_iter y(B.begin() + oy);
             long long x_idx, y_idx;  // line number for Unified Format
             long long px_idx, py_idx; // cordinates
             bool complete = false;
@@ -657,30 +880,25 @@ namespace dtl {
                 // trivial difference
                 if (trivialEnabled()) {
                     if (!wasSwapped()) {
-                        recordOddSequence(x_idx, M, x, SES_DELETE);
-                        recordOddSequence(y_idx, N, y, SES_ADD);
+                        recordOddSequence(x_idx, M, ox, x, SES_DELETE);
+                        recordOddSequence(y_idx, N, oy, y, SES_ADD);
                     } else {
-                        recordOddSequence(x_idx, M, x, SES_ADD);
-                        recordOddSequence(y_idx, N, y, SES_DELETE);
+                        recordOddSequence(x_idx, M, ox, x, SES_ADD);
+                        recordOddSequence(y_idx, N, oy, y, SES_DELETE);
                     }
                     return true;
                 }
 
-                // nontrivial difference
-                sequence A_(A.begin() + (size_t) x_idx - 1, A.end());
-                sequence B_(B.begin() + (size_t) y_idx - 1, B.end());
-                A = A_;
-                B = B_;
-                M = distance(A.begin(), A.end());
-                N = distance(B.begin(), B.end());
+                // nontrivial difference: restart on the unrecorded rest of the window
+                ox += x_idx - 1;
+                oy += y_idx - 1;
+                M -= (size_t) x_idx - 1;
+                N -= (size_t) y_idx - 1;
                 delta = N - M;
                 offset = M + 1;
-                delete[] fp;
-                fp = new long long[M + N + 3];
-                fill(&fp[0], &fp[M + N + 3], -1);
-                fill(path.begin(), path.end(), -1);
-                ox = x_idx - 1;
-                oy = y_idx - 1;
+                work->fp.assign(M + N + 3, -1);
+                fp = work->fp.data();
+                fill(work->path.begin(), work->path.end(), -1);
                 return false;
             }
             return true;
@@ -689,17 +907,343 @@ namespace dtl {
         /**
          * record odd sequence in SES
          */
-        void inline recordOddSequence(long long idx, long long length, sequence_const_iter it, const edit_t et) {
+        void inline recordOddSequence(long long idx, long long length, long long base,
+                                      sequence_const_iter it, const edit_t et) {
             while (idx < length) {
-                ses.addSequence(*it, idx, 0, et);
+                ses.addSequence(*it, idx + base, 0, et);
                 ++it;
                 ++idx;
                 ++editDistance;
             }
-            ses.addSequence(*it, idx, 0, et);
+            ses.addSequence(*it, idx + base, 0, et);
             ++editDistance;
         }
 
+        /**
+         * compare A[x] with B[y] in the caller's original order
+         */
+        bool inline equals(size_t x, size_t y) const {
+            return swapped ? cmp.impl(B[y], A[x]) : cmp.impl(A[x], B[y]);
+        }
+
+        /**
+         * record A[x] == B[y] as a common element of LCS and SES
+         */
+        void inline recordCommon(size_t x, size_t y) {
+            if (editDistanceOnly) {
+                return;
+            }
+            if (!wasSwapped()) {
+                lcs.addSequence(A[x]);
+                ses.addSequence(A[x], (long long) x + 1, (long long) y + 1, SES_COMMON);
+            } else {
+                lcs.addSequence(B[y]);
+                ses.addSequence(B[y], (long long) y + 1, (long long) x + 1, SES_COMMON);
+            }
+        }
+
+        /**
+         * record the shared head and shrink [ox, ox + M) x [oy, oy + N) to
+         * the window after it. The first snake of the search would follow the
+         * same diagonal, so the resulting SES does not change.
+         */
+        void trimCommonPrefix() {
+            size_t prefix = 0;
+            while (prefix < M && prefix < N && equals(prefix, prefix)) {
+                ++prefix;
+            }
+            for (size_t i = 0; i < prefix; ++i) {
+                recordCommon(i, i);
+            }
+            ox = oy = (long long) prefix;
+            M -= prefix;
+            N -= prefix;
+            offset = M + 1;
+        }
+
+        /**
+         * record A[x] which has no counterpart in B
+         */
+        void inline recordOnlyInA(size_t x) {
+            ++editDistance;
+            if (editDistanceOnly) {
+                return;
+            }
+            if (!wasSwapped()) {
+                ses.addSequence(A[x], (long long) x + 1, 0, SES_DELETE);
+            } else {
+                ses.addSequence(A[x], 0, (long long) x + 1, SES_ADD);
+            }
+        }
+
+        /**
+         * record B[y] which has no counterpart in A
+         */
+        void inline recordOnlyInB(size_t y) {
+            ++editDistance;
+            if (editDistanceOnly) {
+                return;
+            }
+            if (!wasSwapped()) {
+                ses.addSequence(B[y], 0, (long long) y + 1, SES_ADD);
+            } else {
+                ses.addSequence(B[y], (long long) y + 1, 0, SES_DELETE);
+            }
+        }
+
+        /**
+         * record the edits of A[x0, x1) against B[y0, y1) in order
+         */
+        void composeBox(long long x0, long long y0, long long x1, long long y1) {
+            while (x0 < x1 && y0 < y1 && equals((size_t) x0, (size_t) y0)) {
+                recordCommon((size_t) x0++, (size_t) y0++);
+            }
+            long long tail = 0;
+            while (x0 < x1 - tail && y0 < y1 - tail && equals((size_t) (x1 - 1 - tail), (size_t) (y1 - 1 - tail))) {
+                ++tail;
+            }
+            x1 -= tail;
+            y1 -= tail;
+
+            if (x0 == x1) {
+                for (long long y = y0; y < y1; ++y) {
+                    recordOnlyInB((size_t) y);
+                }
+            } else if (y0 == y1) {
+                for (long long x = x0; x < x1; ++x) {
+                    recordOnlyInA((size_t) x);
+                }
+            } else {
+                P from = P(), to = P();
+                middleSnake(x0, y0, x1, y1, from, to);
+                composeBox(x0, y0, from.x, from.y);
+                // a middle snake is at most one edit plus a diagonal
+                long long x = from.x, y = from.y;
+                while (x < to.x && y < to.y && equals((size_t) x, (size_t) y)) {
+                    recordCommon((size_t) x++, (size_t) y++);
+                }
+                if (to.x - x > to.y - y) {
+                    recordOnlyInA((size_t) x++);
+                } else if (to.y - y > to.x - x) {
+                    recordOnlyInB((size_t) y++);
+                }
+                while (x < to.x && y < to.y) {
+                    recordCommon((size_t) x++, (size_t) y++);
+                }
+                composeBox(to.x, to.y, x1, y1);
+            }
+
+            for (long long i = 0; i < tail; ++i) {
+                recordCommon((size_t) (x1 + i), (size_t) (y1 + i));
+            }
+        }
+
+        /**
+         * record the edits of A[x0, x1) against B[y0, y1) anchored on unique elements
+         */
+        void composePatienceBox(long long x0, long long y0, long long x1, long long y1) {
+            editPathCordinates anchors;
+            bool shared = true;
+            if (x0 < x1 && y0 < y1) {
+                shared = uniqueAnchors(x0, y0, x1, y1, anchors);
+            }
+            if (!shared) {
+                // a full rewrite of the window, nothing to search for
+                for (long long x = x0; x < x1; ++x) {
+                    recordOnlyInA((size_t) x);
+                }
+                for (long long y = y0; y < y1; ++y) {
+                    recordOnlyInB((size_t) y);
+                }
+                return;
+            }
+            if (anchors.empty()) {
+                composeBox(x0, y0, x1, y1);
+                return;
+            }
+            for (size_t i = 0; i < anchors.size(); ++i) {
+                composePatienceBox(x0, y0, anchors[i].x, anchors[i].y);
+                recordCommon((size_t) anchors[i].x, (size_t) anchors[i].y);
+                x0 = anchors[i].x + 1;
+                y0 = anchors[i].y + 1;
+            }
+            composePatienceBox(x0, y0, x1, y1);
+        }
+
+        /**
+         * collect the longest increasing sequence of elements unique in both windows,
+         * returning false when the windows have no element in common at all
+         */
+        bool uniqueAnchors(long long x0, long long y0, long long x1, long long y1,
+                           editPathCordinates &anchors) const {
+            struct occurrence {
+                long long countA = 0;
+                long long countB = 0;
+                long long x = 0;
+            };
+            std::unordered_map<elem, occurrence> occ;
+            occ.reserve((size_t) (x1 - x0));
+            for (long long x = x0; x < x1; ++x) {
+                occurrence &o = occ[A[(size_t) x]];
+                ++o.countA;
+                o.x = x;
+            }
+            bool shared = false;
+            for (long long y = y0; y < y1; ++y) {
+                typename std::unordered_map<elem, occurrence>::iterator it = occ.find(B[(size_t) y]);
+                if (it != occ.end()) {
+                    ++it->second.countB;
+                    shared = true;
+                }
+            }
+            if (!shared) {
+                return false;
+            }
+
+            // candidates come in order of y, patience sorting keeps the longest run increasing in x
+            editPathCordinates candidates;
+            vector<size_t> piles;
+            for (long long y = y0; y < y1; ++y) {
+                typename std::unordered_map<elem, occurrence>::const_iterator it = occ.find(B[(size_t) y]);
+                if (it == occ.end() || it->second.countA != 1 || it->second.countB != 1) {
+                    continue;
+                }
+                P c;
+                c.x = it->second.x;
+                c.y = y;
+                size_t lo = 0, hi = piles.size();
+                while (lo < hi) {
+                    size_t mid = (lo + hi) / 2;
+                    if (candidates[piles[mid]].x < c.x) {
+                        lo = mid + 1;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                c.k = lo == 0 ? -1 : static_cast<long long>(piles[lo - 1]);
+                if (lo == piles.size()) {
+                    piles.push_back(candidates.size());
+                } else {
+                    piles[lo] = candidates.size();
+                }
+                candidates.push_back(c);
+            }
+            if (piles.empty()) {
+                return true;
+            }
+            anchors.resize(piles.size());
+            long long r = static_cast<long long>(piles.back());
+            for (size_t i = anchors.size(); i > 0; --i) {
+                anchors[i - 1] = candidates[(size_t) r];
+                r = candidates[(size_t) r].k;
+            }
+            return true;
+        }
+
+        /**
+         * find the middle snake of a non-empty box by running the forward and
+         * the backward search until their furthest reaching paths overlap
+         */
+        void middleSnake(long long x0, long long y0, long long x1, long long y1, P &from, P &to) {
+            long long width = x1 - x0;
+            long long height = y1 - y0;
+            long long dlt = width - height;
+            bool odd = (dlt & 1) != 0;
+            long long dmax = (width + height + 1) / 2;
+            long long *f = &work->vf[(size_t) vOffset];
+            long long *b = &work->vb[(size_t) vOffset];
+            f[1] = x0;
+            b[1] = y1;
+            for (long long d = 0; d <= dmax; ++d) {
+                for (long long k = d; k >= -d; k -= 2) {
+                    long long c = k - dlt;
+                    long long px, x;
+                    if (k == -d || (k != d && f[k - 1] < f[k + 1])) {
+                        px = x = f[k + 1];
+                    } else {
+                        px = f[k - 1];
+                        x = px + 1;
+                    }
+                    long long y = y0 + (x - x0) - k;
+                    long long py = (d == 0 || x != px) ? y : y - 1;
+                    while (x < x1 && y < y1 && equals((size_t) x, (size_t) y)) {
+                        ++x;
+                        ++y;
+                    }
+                    f[k] = x;
+                    if (odd && c >= -(d - 1) && c <= d - 1 && y >= b[c]) {
+                        from.x = px;
+                        from.y = py;
+                        to.x = x;
+                        to.y = y;
+                        return;
+                    }
+                }
+                for (long long c = d; c >= -d; c -= 2) {
+                    long long k = c + dlt;
+                    long long py, y;
+                    if (c == -d || (c != d && b[c - 1] > b[c + 1])) {
+                        py = y = b[c + 1];
+                    } else {
+                        py = b[c - 1];
+                        y = py - 1;
+                    }
+                    long long x = x0 + (y - y0) + k;
+                    long long px = (d == 0 || y != py) ? x : x + 1;
+                    while (x > x0 && y > y0 && equals((size_t) (x - 1), (size_t) (y - 1))) {
+                        --x;
+                        --y;
+                    }
+                    b[c] = y;
+                    if (!odd && k >= -d && k <= d && x <= f[k]) {
+                        from.x = x;
+                        from.y = y;
+                        to.x = px;
+                        to.y = py;
+                        return;
+                    }
+                }
+            }
+        }
+
+        /**
+         * apply SES elements to seq starting at pos and append the result to out,
+         * copying each run of common elements from seq at once
+         */
+        static void applySes(const sequence &seq, size_t &pos, const sesElemVec &sesSeq, sequence &out) {
+            size_t commons = 0;
+            for (sesElemVec_const_iter sesIt = sesSeq.begin(); sesIt != sesSeq.end(); ++sesIt) {
+                if (sesIt->second.type == SES_COMMON) {
+                    ++commons;
+                    continue;
+                }
+                if (commons > 0) {
+                    copyCommons(seq, pos, commons, out);
+                    commons = 0;
+                }
+                switch (sesIt->second.type) {
+                    case SES_ADD :
+                        out.push_back(sesIt->first);
+                        break;
+                    case SES_DELETE :
+                        if (pos < seq.size()) {
+                            ++pos;
+                        }
+                        break;
+                    default :
+                        // no through
+                        break;
+                }
+            }
+            copyCommons(seq, pos, commons, out);
+        }
+
+        static void inline copyCommons(const sequence &seq, size_t &pos, size_t count, sequence &out) {
+            size_t end = pos + count < seq.size() ? pos + count : seq.size();
+            out.insert(out.end(), seq.begin() + pos, seq.begin() + end);
+            pos = end;
+        }
+
         /**
          * join SES vectors
          */
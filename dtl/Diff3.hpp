@@ -116,14 +116,12 @@ namespace dtl {
          */
         sequence merge_ () {
             elemVec         seq;
-            Ses< elem >     ses_ba   = diff_ba.getSes();
-            Ses< elem >     ses_bc   = diff_bc.getSes();
-            sesElemVec      ses_ba_v = ses_ba.getSequence();
-            sesElemVec      ses_bc_v = ses_bc.getSequence();
-            sesElemVec_iter ba_it    = ses_ba_v.begin();
-            sesElemVec_iter bc_it    = ses_bc_v.begin();
-            sesElemVec_iter ba_end   = ses_ba_v.end();
-            sesElemVec_iter bc_end   = ses_bc_v.end();
+            const sesElemVec&     ses_ba_v = diff_ba.getSesRef().getSequenceRef();
+            const sesElemVec&     ses_bc_v = diff_bc.getSesRef().getSequenceRef();
+            sesElemVec_const_iter ba_it    = ses_ba_v.begin();
+            sesElemVec_const_iter bc_it    = ses_bc_v.begin();
+            sesElemVec_const_iter ba_end   = ses_ba_v.end();
+            sesElemVec_const_iter bc_end   = ses_bc_v.end();
             
             while (!isEnd(ba_end, ba_it) || !isEnd(bc_end, bc_it)) {
                 while (true) {
@@ -232,7 +230,7 @@ namespace dtl {
         /**
          * add elements whose SES's type is ADD
          */
-        void inline addDecentSequence (const sesElemVec_iter& end, sesElemVec_iter& it, elemVec& seq) const {
+        void inline addDecentSequence (const sesElemVec_const_iter& end, sesElemVec_const_iter& it, elemVec& seq) const {
             while (!isEnd(end, it)) {
                 if (it->second.type == SES_ADD) seq.push_back(it->first);
                 ++it;
@@ -0,0 +1,154 @@
+/**
+   dtl -- Diff Template Library
+   
+   In short, Diff Template Library is distributed under so called "BSD license",
+   
+   Copyright (c) 2015 Tatsuhiko Kubo <cubicdaiya@gmail.com>
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+   
+   * Neither the name of the authors nor the names of its contributors
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* If you use this library, you must include dtl111.hpp only. */
+
+#ifndef DTL_RENDERER_H
+#define DTL_RENDERER_H
+
+#include <charconv>
+#include <string_view>
+
+namespace dtl {
+
+    /**
+     * unified format renderer
+     * Formats hunks into one contiguous buffer with the same bytes UniHunkPrinter
+     * writes, color sequences included unless disabled. The caller writes the
+     * finished buffer out at once instead of flushing every line.
+     */
+    class UniHunkRenderer {
+    public :
+        UniHunkRenderer(bool colored = true) : colored_(colored) {}
+
+        ~UniHunkRenderer() {}
+
+        /**
+         * render a hunk whose elements can be written as text
+         */
+        template<typename sesElem>
+        void operator()(const uniHunk<sesElem> &hunk) {
+            renderHunk(hunk, [](const typename sesElem::first_type &e) -> const typename sesElem::first_type & {
+                return e;
+            });
+        }
+
+        /**
+         * render a hunk, looking up the text of every element with text(elem)
+         */
+        template<typename sesElem, typename resolver>
+        void renderHunk(const uniHunk<sesElem> &hunk, resolver text) {
+            appendHeader(hunk.a, hunk.b, hunk.c, hunk.d);
+            for (size_t i = 0; i < hunk.common[0].size(); ++i) {
+                appendLine(SES_COMMON, text(hunk.common[0][i].first));
+            }
+            for (size_t i = 0; i < hunk.change.size(); ++i) {
+                appendLine(hunk.change[i].second.type, text(hunk.change[i].first));
+            }
+            for (size_t i = 0; i < hunk.common[1].size(); ++i) {
+                appendLine(SES_COMMON, text(hunk.common[1][i].first));
+            }
+        }
+
+        void appendHeader(long long a, long long b, long long c, long long d) {
+            if (colored_) buffer_.append(COLOR_MAGENTA);
+            buffer_.append("@@ -");
+            appendNumber(a);
+            buffer_.push_back(',');
+            appendNumber(b);
+            buffer_.append(" +");
+            appendNumber(c);
+            buffer_.push_back(',');
+            appendNumber(d);
+            buffer_.append(" @@\n");
+            if (colored_) buffer_.append(COLOR_RESET);
+        }
+
+        void appendLine(edit_t type, std::string_view line) {
+            switch (type) {
+                case SES_ADD:
+                    if (colored_) buffer_.append(COLOR_GREEN);
+                    buffer_.append(SES_MARK_ADD);
+                    break;
+                case SES_DELETE:
+                    if (colored_) buffer_.append(COLOR_RED);
+                    buffer_.append(SES_MARK_DELETE);
+                    break;
+                default:
+                    buffer_.append(SES_MARK_COMMON);
+                    break;
+            }
+            buffer_.append(line.data(), line.size());
+            buffer_.push_back('\n');
+            if (colored_ && type != SES_COMMON) buffer_.append(COLOR_RESET);
+        }
+
+        const string &getBuffer() const {
+            return buffer_;
+        }
+
+        size_t size() const {
+            return buffer_.size();
+        }
+
+        void clear() {
+            buffer_.clear();
+        }
+
+        /**
+         * hand the rendered text over without copying it
+         */
+        void swapBuffer(string &other) {
+            buffer_.swap(other);
+        }
+
+    private :
+        static constexpr const char *COLOR_RED     = "\033[31m";
+        static constexpr const char *COLOR_GREEN   = "\033[32m";
+        static constexpr const char *COLOR_MAGENTA = "\033[35m";
+        static constexpr const char *COLOR_RESET   = "\033[0m";
+
+        string buffer_;
+        bool   colored_;
+
+        void appendNumber(long long v) {
+            char digits[24];
+            std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), v);
+            buffer_.append(digits, r.ptr);
+        }
+    };
+}
+
+#endif // DTL_RENDERER_H
@@ -54,6 +54,9 @@ namespace dtl {
         elemVec getSequence () const {
             return sequence;
         }
+        const elemVec& getSequenceRef () const {
+            return sequence;
+        }
         void addSequence (elem e) {
             sequence.push_back(e);
         }
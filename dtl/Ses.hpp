@@ -51,12 +51,8 @@ namespace dtl {
         typedef vector< sesElem >      sesElemVec;
     public :
         
-        Ses () : onlyAdd(true), onlyDelete(true), onlyCopy(true), deletesFirst(false) {
-            nextDeleteIdx = 0;
-        }
-        Ses (bool moveDel) : onlyAdd(true), onlyDelete(true), onlyCopy(true), deletesFirst(moveDel) {
-            nextDeleteIdx = 0;
-        }
+        Ses () : onlyAdd(true), onlyDelete(true), onlyCopy(true), deletesFirst(false) {}
+        Ses (bool moveDel) : onlyAdd(true), onlyDelete(true), onlyCopy(true), deletesFirst(moveDel) {}
         ~Ses () {}
         
         bool isOnlyAdd () const {
@@ -85,47 +81,60 @@ namespace dtl {
             info.beforeIdx = beforeIdx;
             info.afterIdx  = afterIdx;
             info.type      = type;
-            sesElem pe(e, info);
-            if (!deletesFirst) {
-                sequence.push_back(pe);
-            }
+            sesElem pe(std::move(e), info);
             switch (type) {
             case SES_DELETE:
                 onlyCopy   = false;
                 onlyAdd    = false;
-                if (deletesFirst) {
-                    sequence.insert(sequence.begin() + nextDeleteIdx, pe);
-                    nextDeleteIdx++;
-                }
                 break;
             case SES_COMMON:
                 onlyAdd    = false;
                 onlyDelete = false;
-                if (deletesFirst) {
-                    sequence.push_back(pe);
-                    nextDeleteIdx = sequence.size();
-                }
                 break;
             case SES_ADD:
                 onlyDelete = false;
                 onlyCopy   = false;
-                if (deletesFirst) {
-                    sequence.push_back(pe);
-                }
                 break;
             }
+            // deletes of a change run go before its adds: hold the adds back
+            // until the run is closed by a common element or the SES is read
+            if (deletesFirst && type == SES_ADD) {
+                pendingAdds.push_back(std::move(pe));
+                return;
+            }
+            if (deletesFirst && type == SES_COMMON) {
+                flushAdds();
+            }
+            sequence.push_back(std::move(pe));
         }
         
         sesElemVec getSequence () const {
+            flushAdds();
+            return sequence;
+        }
+        
+        /**
+         * access the SES without copying it, valid while this Ses lives
+         */
+        const sesElemVec& getSequenceRef () const {
+            flushAdds();
             return sequence;
         }
     private :
-        sesElemVec sequence;
-        bool       onlyAdd;
-        bool       onlyDelete;
-        bool       onlyCopy;
-        bool       deletesFirst;
-        size_t     nextDeleteIdx;
+        mutable sesElemVec sequence;
+        mutable sesElemVec pendingAdds;
+        bool               onlyAdd;
+        bool               onlyDelete;
+        bool               onlyCopy;
+        bool               deletesFirst;
+        
+        void flushAdds () const {
+            if (pendingAdds.empty()) return;
+            sequence.insert(sequence.end(),
+                            std::make_move_iterator(pendingAdds.begin()),
+                            std::make_move_iterator(pendingAdds.end()));
+            pendingAdds.clear();
+        }
     };
 }
 
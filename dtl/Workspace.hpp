@@ -0,0 +1,72 @@
+/**
+   dtl -- Diff Template Library
+   
+   In short, Diff Template Library is distributed under so called "BSD license",
+   
+   Copyright (c) 2015 Tatsuhiko Kubo <cubicdaiya@gmail.com>
+   All rights reserved.
+   
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+   
+   * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+   
+   * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+   
+   * Neither the name of the authors nor the names of its contributors
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+   
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* If you use this library, you must include dtl111.hpp only. */
+
+#ifndef DTL_WORKSPACE_H
+#define DTL_WORKSPACE_H
+
+namespace dtl {
+
+    /**
+     * scratch buffers of Diff::compose.
+     * Buffers only grow, so a workspace reused across diffs stops allocating
+     * once it has seen the largest input; only pathCordinates can be trimmed
+     * with shrink(). A workspace must not be used by two Diff objects
+     * composing at the same time, keep one per thread.
+     */
+    struct DiffWorkspace {
+        editPath           fp;             // furthest points of O(NP)
+        editPath           path;           // last cordinate on each diagonal
+        editPathCordinates pathCordinates; // every snake of O(NP)
+        editPathCordinates epc;            // path traced back from pathCordinates
+        editPath           vf;             // forward V of the linear space algorithm
+        editPath           vb;             // backward V of the linear space algorithm
+
+        /**
+         * free pathCordinates if it grew beyond maxBytes.
+         * It grows with the number of snakes rather than with the input,
+         * so one diff with many edits can leave tens of MB behind; the other
+         * buffers are sized by the input and are kept for the next diff.
+         */
+        void shrink(size_t maxBytes) {
+            if (pathCordinates.capacity() * sizeof(P) > maxBytes) {
+                editPathCordinates().swap(pathCordinates);
+            }
+        }
+    };
+}
+
+#endif // DTL_WORKSPACE_H
@@ -38,9 +38,11 @@
 
 #include "variables.hpp"
 #include "functors.hpp"
+#include "Renderer.hpp"
 #include "Sequence.hpp"
 #include "Lcs.hpp"
 #include "Ses.hpp"
+#include "Workspace.hpp"
 #include "Diff.hpp"
 #include "Diff3.hpp"
 
@@ -71,7 +71,7 @@ namespace dtl {
         ~CommonPrinter() {}
 
         void operator()(const sesElem &se) const {
-            this->out_ << SES_MARK_COMMON << se.first << endl;
+            this->out_ << SES_MARK_COMMON << se.first << '\n';
         }
     };
 
@@ -90,15 +90,15 @@ namespace dtl {
         void operator()(const sesElem &se) const {
             switch (se.second.type) {
                 case SES_ADD:
-                    this->out_ << TextColor::GREEN << SES_MARK_ADD << se.first << endl;
+                    this->out_ << TextColor::GREEN << SES_MARK_ADD << se.first << '\n';
                     resetColor(this->out_);
                     break;
                 case SES_DELETE:
-                    this->out_ << TextColor::RED << SES_MARK_DELETE << se.first << endl;
+                    this->out_ << TextColor::RED << SES_MARK_DELETE << se.first << '\n';
                     resetColor(this->out_);
                     break;
                 case SES_COMMON:
-                    this->out_ << SES_MARK_COMMON << se.first << endl;
+                    this->out_ << SES_MARK_COMMON << se.first << '\n';
                     break;
             }
         }
@@ -120,7 +120,7 @@ namespace dtl {
             out_ << TextColor::MAGENTA << "@@"
                  << " -" << hunk.a << "," << hunk.b
                  << " +" << hunk.c << "," << hunk.d
-                 << " @@" << endl;
+                 << " @@" << '\n';
             resetColor(out_);
             for_each(hunk.common[0].begin(), hunk.common[0].end(), CommonPrinter<sesElem, stream>(out_));
             for_each(hunk.change.begin(), hunk.change.end(), ChangePrinter<sesElem, stream>(out_));
@@ -43,6 +43,8 @@
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <utility>
 
 namespace dtl {
     
@@ -73,6 +75,14 @@ namespace dtl {
     const   edit_t SES_COMMON = 0;
     const   edit_t SES_ADD    = 1;
     
+    /**
+     * algorithm used by Diff::compose
+     */
+    typedef int algorithm_t;
+    const   algorithm_t DTL_ALGORITHM_ONP          = 0; // O(NP) by Wu, Manber and Myers
+    const   algorithm_t DTL_ALGORITHM_LINEAR_SPACE = 1; // Myers' linear space divide and conquer
+    const   algorithm_t DTL_ALGORITHM_PATIENCE     = 2; // patience diff anchored on unique elements
+
     /**
      * mark of SES
      */
@@ -131,6 +141,7 @@ namespace dtl {
     typedef vector< elem >                    elemVec;                  \
     typedef typename uniHunkVec::iterator     uniHunkVec_iter;          \
     typedef typename sesElemVec::iterator     sesElemVec_iter;          \
+    typedef typename sesElemVec::const_iterator sesElemVec_const_iter;  \
     typedef typename elemList::iterator       elemList_iter;            \
     typedef typename sequence::iterator       sequence_iter;            \
     typedef typename sequence::const_iterator sequence_const_iter;      \
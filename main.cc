@@ -5,11 +5,11 @@ void show_title(const FileWatcher *watcher) {
     assert(watcher);
     static char buffer[80];
     std::fill(buffer, buffer + 80, 0);
-    auto info = watcher->_files_versions.at(watcher->_now_changed_file).back();
-    auto now_c = std::chrono::system_clock::to_time_t(info->timeval);
+    const FileInfo &info = watcher->_files_versions.at(watcher->_now_changed_file).back();
+    auto now_c = std::chrono::system_clock::to_time_t(info.timeval);
     auto now_tm = std::localtime(&now_c);
     std::strftime(buffer, 80, "%Y-%m-%d %H:%M:%S", now_tm);
-    printf("\033[33m The file [%s] was modified at %s\n", info->fileName.c_str(), buffer);
+    printf("\033[33m The file [%s] was modified at %s\n", info.fileName.c_str(), buffer);
     dtl::resetColor(cout);
 }
 
@@ -25,9 +25,9 @@ void show_diff_file_content(const FileWatcher *watcher) {
     if (files.size() <= 1) {
         return;
     }
-    size_t second = files.size() - 1;
-    size_t first = second - 1;
-    diff_file_by_lines(files[first]->contents, files[second]->contents);
+    // 差异已经在工作线程里算好了
+    const std::string &diff = watcher->_now_changed_diff;
+    fwrite(diff.data(), 1, diff.size(), stdout);
     printf("\n\n\n\n");
 }
 
@@ -38,9 +38,19 @@ int main(int argc, char **argv) {
             .is_recursive =     true,
             .is_pre_read =      true,
             ._suffix_files =    {"cc", "h", "txt", "hpp"},
-            .root =             "."
+            .root =             ".",
+            .exclude_globs =    {".git/", "build/", "cmake-build-*/"},
+            .is_gitignore =     true
 
     });
+    if (watcher._is_pre_read) {
+        const auto &stats = watcher._scan_stats;
+        double mb = stats.bytes / (1024.0 * 1024.0);
+        double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+        printf("pre-read %zu files (%zu from snapshot, %zu metadata only, %.1f MB read) in %.3f s, "
+               "%.0f files/s, %.1f MB/s\n", stats.files, stats.restored, stats.stubs, mb, stats.seconds,
+               stats.files / seconds, mb / seconds);
+    }
     watcher.set_printCallbacks(show_title, show_diff_file_content);
     watcher.watch();
 }
@@ -1,12 +1,18 @@
+#pragma once
+
 #include <functional>
 #include "dtl.hpp"
 #include "Diff.hpp"
 #include "functors.hpp"
 #include "variables.hpp"
+#include "LineIndex.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
@@ -15,27 +21,126 @@ using dtl::elemInfo;
 using dtl::uniHunk;
 
 
-static std::vector<string> splitLine(const string &s) {
-    vector<string> lines;
-    stringstream inputs(s);
-    string line;
-    while (std::getline(inputs, line)) {
-        lines.push_back(line);
+/**
+ * 行驻留表
+ * 两个版本共用一张表, 内容相同的行得到同一个稠密的 uint32_t 编号,
+ * Diff 只需比较整数, 打印时再通过编号取回原始行。
+ * 表中只保存原始行的视图, 原始行必须比驻留表活得更久。
+ */
+class LineInterner {
+public:
+    uint32_t intern(std::string_view line, uint64_t hash) {
+        auto [it, inserted] = _ids.try_emplace(LineKey{line, hash}, static_cast<uint32_t>(_lines.size()));
+        if (inserted)
+            _lines.push_back(line);
+        return it->second;
+    }
+
+    /**
+     * 按带换行符的整行驻留, 建索引时已经算好了每行的哈希, 这里直接拿来用, 不再重新哈希
+     */
+    vector<uint32_t> intern_all(const LineIndex &lines) {
+        vector<uint32_t> ids;
+        ids.reserve(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i)
+            ids.push_back(intern(lines.raw(i), lines.hashes[i]));
+        return ids;
+    }
+
+    std::string_view line(uint32_t id) const {
+        return _lines[id];
     }
-    return lines;
+
+private:
+    struct LineKey {
+        std::string_view text;
+        uint64_t hash;
+
+        bool operator==(const LineKey &other) const {
+            return hash == other.hash && text == other.text;
+        }
+    };
+
+    struct LineKeyHash {
+        size_t operator()(const LineKey &key) const {
+            return static_cast<size_t>(key.hash);
+        }
+    };
+
+    std::unordered_map<LineKey, uint32_t, LineKeyHash> _ids;
+    std::vector<std::string_view> _lines;
+};
+
+// 两个版本合计超过这么多行时改用线性空间的算法, 避免 O(NP) 路径表过大
+static const size_t LINEAR_SPACE_LINES = 1 << 18;
+
+// 工作区里记录 O(NP) 每条蛇的缓冲区比完后最多留这么多字节, 偶尔一次改动很多的比较用过的内存还回去。
+// 其余缓冲区只和行数有关, 一直留着复用
+static const size_t WORKSPACE_RETAIN_BYTES = 8 << 20;
+
+/**
+ * 本线程的工作区, 展示差异和计算差量共用一份
+ */
+inline dtl::DiffWorkspace &thread_workspace() {
+    static thread_local dtl::DiffWorkspace workspace;
+    return workspace;
 }
 
-static void diff_file_by_lines(const string &alines, const string &blines) {
-    vector<string> ALines, BLines;
-    using sesElem = std::pair<string, dtl::elemInfo>;
-    ALines = splitLine(alines);
-    BLines = splitLine(blines);
-    Diff<string> diff(ALines, BLines);
-    diff.onHuge();
-    diff.compose();
-    uniHunk<sesElem> hunk;
-    diff.composeUnifiedHunks();
-    diff.printUnifiedFormat();
+/**
+ * 在本线程的工作区里比较两个按行驻留的版本, lines 是两边合计的行数, 太多时 O(NP) 换成线性空间的算法
+ */
+static void compose_lines(Diff<uint32_t> &diff, size_t lines, dtl::algorithm_t algorithm = dtl::DTL_ALGORITHM_ONP) {
+    dtl::DiffWorkspace &workspace = thread_workspace();
+    diff.setWorkspace(&workspace);
+    diff.enableTrimming();
+    if (algorithm == dtl::DTL_ALGORITHM_ONP && lines > LINEAR_SPACE_LINES)
+        algorithm = dtl::DTL_ALGORITHM_LINEAR_SPACE;
+    diff.compose(algorithm);
+    diff.setWorkspace(nullptr);
+    workspace.shrink(WORKSPACE_RETAIN_BYTES);
 }
 
+/**
+ * 两个版本按带换行符的整行比较一次的结果, 展示差异和计算差量共用这一份 SES。
+ * 行尾的 '\r' 和最后一行有没有换行符都算在行内, 由 SES 打补丁能逐字节还原原文。
+ * 行索引和驻留表都只保存视图, 两个版本的内容必须比它活得更久。
+ */
+struct LineComparison {
+    LineIndex before;
+    LineIndex after;
+    LineInterner interner;
+    Diff<uint32_t> diff;
+
+    LineComparison(std::string_view older, std::string_view newer, dtl::algorithm_t algorithm = dtl::DTL_ALGORITHM_ONP)
+            : before(index_lines(older, true)), after(index_lines(newer, true)),
+              diff(interner.intern_all(before), interner.intern_all(after)) {
+        compose_lines(diff, before.size() + after.size(), algorithm);
+    }
+
+    /**
+     * 把统一格式的差异渲染进 out。
+     * 每个 hunk 一闭合就按编号取回原始行, 去掉行尾的 '\n' 后渲染, 输出与按 std::getline 切行比较时逐字节一致;
+     * 只差在最后一行有没有换行符时显示为这一行删掉又加上。
+     */
+    void render(dtl::UniHunkRenderer &out) {
+        using idSesElem = std::pair<uint32_t, dtl::elemInfo>;
+        auto line_of = [this](uint32_t id) {
+            std::string_view line = interner.line(id);
+            if (!line.empty() && line.back() == '\n')
+                line.remove_suffix(1);
+            return line;
+        };
+        diff.composeUnifiedHunks([&](const uniHunk<idSesElem> &hunk) {
+            out.renderHunk(hunk, line_of);
+        });
+    }
+};
 
+/**
+ * 比较两个版本, 把统一格式的差异渲染进 out。
+ * 行尾的 '\r' 算在行内, LF 与 CRLF 之间的转换照样显示为改动。
+ */
+static void diff_file_by_lines(std::string_view alines, std::string_view blines, dtl::UniHunkRenderer &out,
+                               dtl::algorithm_t algorithm = dtl::DTL_ALGORITHM_ONP) {
+    LineComparison(alines, blines, algorithm).render(out);
+}